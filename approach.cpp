@@ -0,0 +1,67 @@
+#include "approach.h"
+#include "kinetic.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <atomic>
+
+#define J2000_EPOCH 2000.0
+
+// Kept apart from the map's kinetic_index, which is rebuilt around
+// whatever epoch is shown. Built on the first search after each
+// index_stars().
+static KineticIndex approach_index;
+static const bool cleared = on_index_stars([]() { approach_index.Clear(); });
+
+// position at J2000
+static Vector j2000_pos(const Star *star)
+{
+  return star->pos + star->motion * (J2000_EPOCH - star->epoch);
+}
+
+bool find_approaches(const Star *ref, double max_dist, double years,
+                     std::vector<Approach>& out)
+{
+  out.clear();
+  if (ref && !ref->has_motion) return false;
+  Vector ref_pos = ref ? j2000_pos(ref) : Vector::null;
+  Vector ref_motion = ref ? ref->motion : Vector::null;
+
+  // Each node of the kinetic index bounds the motion of its own stars,
+  // so only subtrees whose paths can come close enough are searched.
+  if (approach_index.IsEmpty()) approach_index.Build(J2000_EPOCH, 0.0);
+  std::vector<const Star*> candidates;
+  approach_index.ForEachNearPath(ref_pos, ref_motion, J2000_EPOCH, max_dist, -years, years,
+                                 [&](const StarIndex::Entry& entry) {
+    if (entry.star != ref && entry.star->has_motion) candidates.push_back(entry.star);
+  });
+
+  // closest approach on each relative trajectory, limited to the time span
+  std::vector<Approach> found(candidates.size());
+  std::atomic<size_t> count(0);
+  parallel_for(candidates.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      const Star *star = candidates[n];
+      Vector rel = j2000_pos(star) - ref_pos;
+      Vector vel = star->motion - ref_motion;
+      double v2 = vel.sqr();
+      double t = 0.0;
+      if (v2 > 0.0) {
+        t = -(rel.get_x() * vel.get_x() + rel.get_y() * vel.get_y() + rel.get_z() * vel.get_z()) / v2;
+        t = std::max(-years, std::min(years, t));
+      }
+      double dist = (rel + vel * t).norm();
+      if (dist <= max_dist) {
+        found[count++] = {star, J2000_EPOCH + t, dist};
+      }
+    }
+  }, 256);
+  found.resize(count);
+
+  std::sort(found.begin(), found.end(), [](const Approach& a, const Approach& b) {
+    return a.distance < b.distance || (a.distance == b.distance && a.star->id < b.star->id);
+  });
+  out.swap(found);
+  return true;
+}
@@ -0,0 +1,22 @@
+#ifndef STARMAP_APPROACH_H
+#define STARMAP_APPROACH_H
+
+#include <vector>
+
+class Star;
+
+struct Approach {
+  const Star *star;
+  double time;     // year of closest approach
+  double distance; // parsecs
+};
+
+// Find the stars whose straight-line paths pass within max_dist parsecs of
+// ref (or of the Sun, if ref is NULL) at some point within the given number
+// of years before or after J2000. Only stars with known proper motion are
+// considered. Returns false if ref itself has no known motion; otherwise,
+// out holds the approaches, closest first.
+bool find_approaches(const Star *ref, double max_dist, double years,
+                     std::vector<Approach>& out);
+
+#endif //STARMAP_APPROACH_H
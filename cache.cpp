@@ -0,0 +1,269 @@
+#include "cache.h"
+#include "import.h"
+#include "neighbours.h"
+#include "starlist.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+
+namespace {
+
+const char cache_magic[8] = { 'S', 'T', 'A', 'R', 'M', 'A', 'P', 'C' };
+// bump whenever the layout below, or the meaning of a Star field, changes
+const uint32_t cache_version = 4;
+// Values are written as they are in memory, so a cache is only read back
+// where these come out the same: same byte order, same doubles.
+const uint32_t cache_byte_order = 0x01020304;
+const double cache_double = -1.5;
+
+class CacheWriter {
+public:
+  explicit CacheWriter(std::ostream& out): _out(out) {}
+
+  template<typename T> void Put(T value) {
+    _out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  void PutVector(const Vector& v) {
+    double x, y, z;
+    v.get(x, y, z);
+    Put(x);
+    Put(y);
+    Put(z);
+  }
+  void PutString(const wxString& str) {
+    wxScopedCharBuffer utf8 = str.utf8_str();
+    Put((uint32_t)utf8.length());
+    _out.write(utf8.data(), utf8.length());
+  }
+
+protected:
+  std::ostream& _out;
+};
+
+class CacheReader {
+public:
+  explicit CacheReader(std::istream& in): _in(in) {}
+
+  bool IsOk() const { return (bool)_in; }
+
+  template<typename T> T Get() {
+    T value = T();
+    _in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+  }
+  Vector GetVector() {
+    double x = Get<double>(), y = Get<double>(), z = Get<double>();
+    return Vector(x, y, z);
+  }
+  wxString GetString() {
+    uint32_t length = Get<uint32_t>();
+    if (!_in || length > (1u << 24)) {
+      _in.setstate(std::ios::failbit);
+      return wxString();
+    }
+    _buffer.resize(length);
+    _in.read(_buffer.data(), length);
+    return wxString::FromUTF8(_buffer.data(), length);
+  }
+
+protected:
+  std::istream& _in;
+  std::vector<char> _buffer;
+};
+
+void put_star(CacheWriter& out, const Star *star)
+{
+  out.Put((uint8_t)star->is3d);
+  out.Put((int32_t)star->comp);
+  out.Put((uint32_t)star->catalogs);
+  out.PutVector(star->pos);
+  out.PutVector(star->motion);
+  out.Put(star->epoch);
+  out.Put((uint8_t)star->has_motion);
+  out.Put(star->vmag);
+  out.PutString(star->type);
+  out.Put((uint8_t)star->color.Red());
+  out.Put((uint8_t)star->color.Green());
+  out.Put((uint8_t)star->color.Blue());
+  out.Put(star->temp);
+  out.PutString(star->remarks);
+  out.Put((uint32_t)star->names.size());
+  for (const auto& nit : star->names) {
+    out.PutString(nit.name);
+    out.Put((int32_t)nit.priority);
+  }
+}
+
+Star *get_star(CacheReader& in)
+{
+  Star *star = new Star;
+  star->is3d = in.Get<uint8_t>() != 0;
+  star->comp = in.Get<int32_t>();
+  star->catalogs = in.Get<uint32_t>();
+  star->pos = in.GetVector();
+  star->motion = in.GetVector();
+  star->epoch = in.Get<double>();
+  star->has_motion = in.Get<uint8_t>() != 0;
+  star->vmag = in.Get<double>();
+  star->type = in.GetString();
+  unsigned char r = in.Get<uint8_t>(), g = in.Get<uint8_t>(), b = in.Get<uint8_t>();
+  star->color = wxColour(r, g, b);
+  star->temp = in.Get<double>();
+  star->remarks = in.GetString();
+  uint32_t names = in.Get<uint32_t>();
+  for (uint32_t n = 0; n < names && in.IsOk(); n++) {
+    wxString name = in.GetString();
+    int priority = in.Get<int32_t>();
+    star->names.emplace_back(name, priority);
+  }
+  return star;
+}
+
+// size and modification time of a catalog file, -1 and 0 if it's missing
+void put_source(CacheWriter& out, const wxString& path)
+{
+  bool exists = wxFileExists(path);
+  out.PutString(path);
+  out.Put(exists ? (int64_t)wxFileName::GetSize(path).GetValue() : (int64_t)-1);
+  out.Put(exists ? (int64_t)wxFileModificationTime(path) : (int64_t)0);
+}
+
+bool same_source(CacheReader& in, const wxString& path)
+{
+  bool exists = wxFileExists(path);
+  wxString name = in.GetString();
+  int64_t size = in.Get<int64_t>(), mtime = in.Get<int64_t>();
+  return in.IsOk() && name == path &&
+    size == (exists ? (int64_t)wxFileName::GetSize(path).GetValue() : -1) &&
+    mtime == (exists ? (int64_t)wxFileModificationTime(path) : 0);
+}
+
+void clear_stars()
+{
+  for (const auto list : { &stars, &dir_stars }) {
+    for (Star *star : *list) {
+      delete star;
+    }
+    list->clear();
+  }
+}
+
+}
+
+bool save_star_cache(const wxString& path, bool crossmatch)
+{
+  std::ofstream file(path.fn_str(), std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  CacheWriter out(file);
+  file.write(cache_magic, sizeof(cache_magic));
+  out.Put(cache_version);
+  out.Put(cache_byte_order);
+  out.Put(cache_double);
+  out.Put((uint8_t)crossmatch);
+
+  const auto sources = catalog_files();
+  out.Put((uint32_t)sources.size());
+  for (const auto& path : sources) {
+    put_source(out, path);
+  }
+
+  const auto& catalogs = get_catalog_names();
+  out.Put((uint32_t)catalogs.size());
+  for (const auto& name : catalogs) {
+    out.PutString(name);
+  }
+  for (const auto list : { &stars, &dir_stars }) {
+    out.Put((uint64_t)list->size());
+    for (const Star *star : *list) {
+      put_star(out, star);
+    }
+  }
+
+  // the neighbour graph (if there's one), by star id, so it needn't be
+  // rebuilt after loading
+  size_t k = neighbour_graph.GetK();
+  const auto& links = neighbour_graph.GetLinks();
+  const auto& counts = neighbour_graph.GetCounts();
+  out.Put((uint32_t)k);
+  for (size_t id = 0; id < counts.size(); id++) {
+    out.Put((uint32_t)counts[id]);
+    for (size_t n = 0; n < counts[id]; n++) {
+      out.Put((uint32_t)links[id * k + n].second->id);
+      out.Put(links[id * k + n].first);
+    }
+  }
+  file.close();
+  return (bool)file;
+}
+
+bool load_star_cache(const wxString& path, bool crossmatch)
+{
+  std::ifstream file(path.fn_str(), std::ios::binary);
+  if (!file) return false;
+  CacheReader in(file);
+  char magic[sizeof(cache_magic)];
+  file.read(magic, sizeof(magic));
+  if (!file || memcmp(magic, cache_magic, sizeof(magic)) != 0) return false;
+  if (in.Get<uint32_t>() != cache_version) return false;
+  if (in.Get<uint32_t>() != cache_byte_order) return false;
+  if (in.Get<double>() != cache_double) return false;
+  if ((in.Get<uint8_t>() != 0) != crossmatch) return false;
+
+  // a catalog file that changed since makes the cache stale
+  const auto sources = catalog_files();
+  if (in.Get<uint32_t>() != sources.size()) return false;
+  for (const auto& path : sources) {
+    if (!same_source(in, path)) return false;
+  }
+
+  // Star::catalogs has one bit per catalog
+  uint32_t catalog_count = in.Get<uint32_t>();
+  if (!in.IsOk() || catalog_count > 32) return false;
+  std::vector<wxString> catalogs(catalog_count);
+  for (auto& name : catalogs) {
+    name = in.GetString();
+  }
+  for (const auto list : { &stars, &dir_stars }) {
+    uint64_t count = in.Get<uint64_t>();
+    for (uint64_t n = 0; n < count && in.IsOk(); n++) {
+      list->push_back(get_star(in));
+    }
+  }
+
+  // star ids are positions in the star list, as index_stars() assigns them
+  size_t n = stars.size();
+  uint32_t k = in.Get<uint32_t>();
+  bool ok = in.IsOk() && k <= MAX_NEIGHBOURS;
+  std::vector<uint32_t> link_ids(ok ? n * k : 0);
+  std::vector<NeighbourGraph::Neighbour> links(link_ids.size(), NeighbourGraph::Neighbour(0.0, nullptr));
+  std::vector<unsigned> counts(ok && k > 0 ? n : 0);
+  for (size_t id = 0; id < counts.size() && ok; id++) {
+    counts[id] = in.Get<uint32_t>();
+    ok = in.IsOk() && counts[id] <= k;
+    for (size_t m = id * k; ok && m < id * k + counts[id]; m++) {
+      link_ids[m] = in.Get<uint32_t>();
+      links[m].first = in.Get<double>();
+      ok = in.IsOk() && link_ids[m] < n;
+    }
+  }
+  if (!ok) {
+    clear_stars();
+    return false;
+  }
+
+  adopt_stars(catalogs);
+  index_stars();
+  for (size_t m = 0; m < links.size(); m++) {
+    links[m].second = star_table[link_ids[m]];
+  }
+  if (k > 0) {
+    neighbour_graph.Adopt(k, links, counts);
+  } else {
+    neighbour_graph.Build(MAX_NEIGHBOURS);
+  }
+  return true;
+}
@@ -0,0 +1,19 @@
+#ifndef STARMAP_CACHE_H
+#define STARMAP_CACHE_H
+
+#include <wx/string.h>
+
+// A binary snapshot of the merged star lists and their neighbour graph,
+// which loads much faster than parsing and merging the catalogs again. The
+// file records whether the stars were cross-matched, and the size and time
+// of each catalog file; a cache made the other way, or from other files,
+// is rejected. So is one written on a machine with another byte order.
+
+bool save_star_cache(const wxString& path, bool crossmatch);
+
+// Fills the (empty) star lists from the cache, and indexes them.
+// Returns false, leaving the lists empty, if the file is missing,
+// damaged, from another version, made with other options or out of date.
+bool load_star_cache(const wxString& path, bool crossmatch);
+
+#endif //STARMAP_CACHE_H
@@ -0,0 +1,119 @@
+#include "crossmatch.h"
+#include "import.h"
+#include "parallel.h"
+#include "sky.h"
+#include "starlist.h"
+
+#include <unordered_map>
+#include <vector>
+#include <wx/log.h>
+
+#define ARCSEC (M_PI / (180.0 * 3600.0))
+
+// What we need to know about each star to compare it with another.
+struct match_star {
+  Star *star;
+  Vector dir;    // unit direction vector
+  double plx;    // parallax (milliarcsec), or NAN
+  double appmag; // apparent visual magnitude
+};
+
+static bool fill_match_star(match_star& ms, Star *star)
+{
+  ms.star = star;
+  ms.dir = star->pos;
+  if (star->is3d) {
+    double dist = star->pos.norm();
+    if (dist <= 0.0) return false; // the Sun has no direction
+    ms.dir /= dist;
+    ms.plx = 1000.0 / dist;
+    ms.appmag = star->vmag + 5.0 * (log10(dist) - 1.0);
+  } else {
+    ms.plx = NAN;
+    ms.appmag = star->vmag;
+  }
+  return true;
+}
+
+static bool is_match(const match_star& a, const match_star& b, const CrossMatchOptions& options)
+{
+  // Catalogs don't list the same star twice, so anything from a common
+  // catalog has to be a different star, even if it's close in the sky.
+  if (a.star->catalogs & b.star->catalogs) return false;
+  // Nor do we want to collapse the components of a binary system.
+  if (a.star->comp && b.star->comp && a.star->comp != b.star->comp) return false;
+  if (!std::isnan(a.plx) && !std::isnan(b.plx) &&
+      fabs(a.plx - b.plx) > options.max_parallax_diff) return false;
+  if (fabs(a.appmag - b.appmag) > options.max_magnitude_diff) return false;
+  return true;
+}
+
+static unsigned crossmatch_pass(const CrossMatchOptions& options)
+{
+  // Collect every star, 3D ones first, so that the 3D record tends to be
+  // the one that survives.
+  std::vector<match_star> all;
+  all.reserve(stars.size() + dir_stars.size());
+  for (Star *star : stars) {
+    match_star ms;
+    if (fill_match_star(ms, star)) all.push_back(ms);
+  }
+  for (Star *star : dir_stars) {
+    match_star ms;
+    if (fill_match_star(ms, star)) all.push_back(ms);
+  }
+
+  // index the directions
+  SkyIndex index;
+  index.Reserve(all.size());
+  for (const auto& ms : all) {
+    index.Add(ms.star, ms.dir);
+  }
+  index.Build();
+
+  std::unordered_map<const Star*, size_t> pos_of;
+  for (size_t n = 0; n < all.size(); n++) {
+    pos_of[all[n].star] = n;
+  }
+
+  // find each star's closest acceptable counterpart
+  std::vector<size_t> best(all.size(), SIZE_MAX);
+  double radius = options.max_separation * ARCSEC;
+  parallel_for(all.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      double best_cos = -INFINITY;
+      index.ForEachInCone(all[n].dir, radius, [&](const SkyIndex::Entry& entry, double cos_sep) {
+        if (entry.star == all[n].star || cos_sep <= best_cos) return;
+        size_t m = pos_of.find(entry.star)->second;
+        if (!is_match(all[n], all[m], options)) return;
+        best_cos = cos_sep;
+        best[n] = m;
+      });
+    }
+  }, 256);
+
+  // only merge pairs that agree they're each other's best match
+  std::vector<std::pair<Star*, Star*>> pairs;
+  for (size_t n = 0; n < all.size(); n++) {
+    size_t m = best[n];
+    if (m == SIZE_MAX || m < n || best[m] != n) continue;
+    wxLogVerbose(wxT("Cross-matching star %s with %s"),
+                 all[n].star->names.front().name, all[m].star->names.front().name);
+    pairs.emplace_back(all[n].star, all[m].star);
+  }
+  merge_duplicates(pairs);
+  return (unsigned)pairs.size();
+}
+
+unsigned crossmatch_stars(const CrossMatchOptions& options)
+{
+  // A star may be in three or more catalogs, so keep going
+  // until there's nothing left to merge.
+  unsigned total = 0, merged;
+  do {
+    merged = crossmatch_pass(options);
+    total += merged;
+  } while (merged);
+  wxLogVerbose(wxT("Cross-matched %u stars by position."), total);
+  return total;
+}
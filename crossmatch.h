@@ -0,0 +1,19 @@
+#ifndef STARMAP_CROSSMATCH_H
+#define STARMAP_CROSSMATCH_H
+
+// Positional cross-matching, for records of the same physical star that
+// share no designation and thus weren't merged by name.
+
+struct CrossMatchOptions {
+  // maximum angular separation between the two records
+  double max_separation = 60.0; // arcsec
+  // maximum parallax difference, when both records have one
+  double max_parallax_diff = 10.0; // milliarcsec
+  // maximum difference in apparent visual magnitude
+  double max_magnitude_diff = 1.0;
+};
+
+// Merges matching stars, returns the number of merges performed.
+unsigned crossmatch_stars(const CrossMatchOptions& options);
+
+#endif //STARMAP_CROSSMATCH_H
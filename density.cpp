@@ -0,0 +1,148 @@
+#include "density.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+
+// absolute visual magnitude of the Sun
+#define SUN_VMAG 4.83
+
+constexpr double DensityMap::cell;
+constexpr double DensityMap::extent;
+
+DensityMap density_map;
+static const bool cleared = on_index_stars([]() { density_map.Clear(); });
+
+void DensityMap::Clear()
+{
+  _nx = _ny = _nz = 0;
+  _count.clear();
+  _light.clear();
+  _slab = wxImage();
+  _generation++;
+}
+
+void DensityMap::Build()
+{
+  Clear();
+  size_t count = star_table.size();
+
+  // fit the grid to the stars, but no further out than the extent
+  double lo[3] = { extent, extent, extent }, hi[3] = { -extent, -extent, -extent };
+  for (const Star *star : star_table) {
+    double c[3];
+    star->get_pos().get(c[0], c[1], c[2]);
+    for (unsigned a = 0; a < 3; a++) {
+      lo[a] = std::min(lo[a], std::max(c[a], -extent));
+      hi[a] = std::max(hi[a], std::min(c[a], extent));
+    }
+  }
+  unsigned dims[3];
+  for (unsigned a = 0; a < 3; a++) {
+    if (hi[a] < lo[a]) lo[a] = hi[a] = 0.0;
+    _origin[a] = floor(lo[a] / cell) * cell;
+    dims[a] = (unsigned)((hi[a] - _origin[a]) / cell) + 1;
+  }
+
+  // find every star's voxel, and sort the stars by layer
+  std::vector<int64_t> voxel(count, -1);
+  parallel_for(count, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      double c[3];
+      star_table[n]->get_pos().get(c[0], c[1], c[2]);
+      int64_t index = 0;
+      for (int a = 2; a >= 0; a--) {
+        double v = floor((c[a] - _origin[a]) / cell);
+        if (!(fabs(c[a]) <= extent && v >= 0.0 && v < dims[a])) {
+          index = -1;
+          break;
+        }
+        index = index * dims[a] + (int64_t)v;
+      }
+      voxel[n] = index;
+    }
+  });
+  size_t layer_size = (size_t)dims[0] * dims[1];
+  std::vector<size_t> layer_first(dims[2] + 1, 0);
+  for (int64_t index : voxel) {
+    if (index >= 0) layer_first[index / layer_size + 1]++;
+  }
+  for (unsigned z = 0; z < dims[2]; z++) {
+    layer_first[z + 1] += layer_first[z];
+  }
+  std::vector<size_t> by_layer(layer_first[dims[2]]);
+  {
+    std::vector<size_t> next(layer_first.begin(), layer_first.end() - 1);
+    for (size_t n = 0; n < count; n++) {
+      if (voxel[n] >= 0) by_layer[next[voxel[n] / layer_size]++] = n;
+    }
+  }
+
+  // Each layer is binned by one thread, in star order,
+  // so the sums come out the same every time.
+  _count.assign(layer_size * dims[2], 0);
+  _light.assign(layer_size * dims[2], 0.0f);
+  parallel_for(dims[2], [&](size_t begin, size_t end) {
+    for (size_t n = layer_first[begin]; n < layer_first[end]; n++) {
+      size_t star = by_layer[n];
+      _count[voxel[star]]++;
+      _light[voxel[star]] += (float)pow(10.0, -0.4 * (star_table[star]->vmag - SUN_VMAG));
+    }
+  }, 1);
+
+  _nx = dims[0];
+  _ny = dims[1];
+  _nz = dims[2];
+}
+
+// black through blue and red to yellow, kept dim enough for stars to show
+static void heat_color(double t, unsigned char& r, unsigned char& g, unsigned char& b)
+{
+  r = (unsigned char)(std::min(1.0, t * 2.0) * 160);
+  g = (unsigned char)(std::max(0.0, t * 2.0 - 1.0) * 140);
+  b = (unsigned char)(std::max(0.0, 0.6 - fabs(t - 0.3) * 2.0) * 200);
+}
+
+const wxImage& DensityMap::GetSlab(DensityMeasure measure, double z1, double z2)
+{
+  if (!IsBuilt()) Build();
+  int l1 = std::max(0, (int)floor((z1 - _origin[2]) / cell));
+  int l2 = std::min((int)_nz - 1, (int)floor((z2 - _origin[2]) / cell));
+  if (_slab.IsOk() && measure == _slab_measure && l1 == _slab_z1 && l2 == _slab_z2) {
+    return _slab;
+  }
+
+  // total each column over the slab's layers
+  size_t layer_size = (size_t)_nx * _ny;
+  std::vector<double> total(layer_size, 0.0);
+  parallel_for(_ny, [&](size_t begin, size_t end) {
+    for (size_t n = begin * _nx; n < end * _nx; n++) {
+      for (int z = l1; z <= l2; z++) {
+        size_t index = z * layer_size + n;
+        total[n] += measure == DENSITY_COUNT ? (double)_count[index] : (double)_light[index];
+      }
+    }
+  }, 16);
+
+  // logarithmic scale, so that sparse regions still show up
+  double top = 0.0;
+  for (double v : total) {
+    top = std::max(top, v);
+  }
+  double scale = top > 0.0 ? 1.0 / log1p(top) : 0.0;
+  _slab = wxImage(_nx, _ny);
+  for (unsigned y = 0; y < _ny; y++) {
+    for (unsigned x = 0; x < _nx; x++) {
+      unsigned char r, g, b;
+      double v = total[(size_t)y * _nx + x];
+      if (v > 0.0) heat_color(log1p(v) * scale, r, g, b);
+      else r = g = b = 0;
+      _slab.SetRGB(x, y, r, g, b);
+    }
+  }
+  _slab_measure = measure;
+  _slab_z1 = l1;
+  _slab_z2 = l2;
+  _generation++;
+  return _slab;
+}
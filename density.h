@@ -0,0 +1,55 @@
+#ifndef STARMAP_DENSITY_H
+#define STARMAP_DENSITY_H
+
+#include <cstdint>
+#include <vector>
+#include <wx/image.h>
+
+enum DensityMeasure {
+  DENSITY_COUNT,     // number of stars
+  DENSITY_LUMINOSITY // total luminosity
+};
+
+// Star counts and luminosities binned into a voxel grid around the Sun.
+// Built once per catalog load (using all cores), and kept until the star
+// list changes. A slab of the grid can be rendered into an image with
+// one pixel per column of voxels, which is cached until asked for
+// another slab.
+
+class DensityMap {
+public:
+  static constexpr double cell = 2.0;    // voxel size, parsecs
+  static constexpr double extent = 128.0; // stars further out along any axis are left out
+
+  DensityMap(): _nx(0), _ny(0), _nz(0), _generation(0) {}
+
+  void Clear();
+  bool IsBuilt() const { return _nz != 0; }
+  void Build();
+
+  // Image of the layers that overlap [z1, z2], with column x, row y
+  // covering the cell starting at GetOrigin() + (x, y) * cell.
+  const wxImage& GetSlab(DensityMeasure measure, double z1, double z2);
+  // changes whenever the slab image does
+  unsigned GetGeneration() const { return _generation; }
+
+  double GetOriginX() const { return _origin[0]; }
+  double GetOriginY() const { return _origin[1]; }
+  unsigned GetColumns() const { return _nx; }
+  unsigned GetRows() const { return _ny; }
+
+protected:
+  double _origin[3];
+  unsigned _nx, _ny, _nz;
+  std::vector<uint32_t> _count; // by voxel, x fastest
+  std::vector<float> _light;    // solar luminosities
+
+  wxImage _slab;
+  DensityMeasure _slab_measure;
+  int _slab_z1, _slab_z2;
+  unsigned _generation;
+};
+
+extern DensityMap density_map;
+
+#endif //STARMAP_DENSITY_H
@@ -0,0 +1,47 @@
+#ifndef STARMAP_DISJOINT_H
+#define STARMAP_DISJOINT_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Lock-free union-find over indices 0..count-1. The root of each set is
+// always its lowest index, so the result doesn't depend on the
+// order in which threads happen to unite things.
+class disjoint_sets {
+public:
+  explicit disjoint_sets(size_t count): parent(count) {
+    for (size_t n = 0; n < count; n++) {
+      parent[n].store(n, std::memory_order_relaxed);
+    }
+  }
+
+  size_t find(size_t n) {
+    while (true) {
+      size_t p = parent[n].load(std::memory_order_relaxed);
+      if (p == n) return n;
+      size_t gp = parent[p].load(std::memory_order_relaxed);
+      // path halving; harmless if it races with another update
+      if (gp != p) parent[n].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+      n = gp;
+    }
+  }
+
+  void unite(size_t a, size_t b) {
+    while (true) {
+      a = find(a);
+      b = find(b);
+      if (a == b) return;
+      if (a < b) std::swap(a, b);
+      // link the higher root below the lower one
+      size_t expected = a;
+      if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+    }
+  }
+
+protected:
+  std::vector<std::atomic<size_t>> parent;
+};
+
+#endif //STARMAP_DISJOINT_H
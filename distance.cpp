@@ -0,0 +1,94 @@
+#include "distance.h"
+#include "filter.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <cmath>
+#include <cstring>
+
+RefDistances ref_distances;
+static const bool cleared = on_index_stars([]() { ref_distances.Clear(); });
+
+void RefDistances::Clear()
+{
+  _valid = false;
+  _sorted = false;
+  _dist2.clear();
+  _order.clear();
+}
+
+void RefDistances::Update(const Vector& ref)
+{
+  double rx, ry, rz;
+  ref.get(rx, ry, rz);
+  if (_valid && rx == _ref[0] && ry == _ref[1] && rz == _ref[2]) return;
+  _ref[0] = rx;
+  _ref[1] = ry;
+  _ref[2] = rz;
+
+  if (!star_columns.IsBuilt()) star_columns.Build();
+  const StarColumns& col = star_columns;
+  size_t count = col.Size();
+  _dist2.resize(count);
+
+  // plain loops over the coordinate arrays, which the compiler vectorizes
+  const float fx = (float)rx, fy = (float)ry, fz = (float)rz;
+  const float *x = col.x.data(), *y = col.y.data(), *z = col.z.data();
+  float *dist2 = _dist2.data();
+  parallel_for(count, [=](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      float dx = x[n] - fx, dy = y[n] - fy, dz = z[n] - fz;
+      dist2[n] = dx * dx + dy * dy + dz * dz;
+    }
+  }, 16384);
+  _valid = true;
+  _sorted = false;
+}
+
+float RefDistances::Get(const Star *star) const
+{
+  if (!star->is3d || star->id >= _dist2.size()) return NAN;
+  return std::sqrt(_dist2[star->id]);
+}
+
+const std::vector<uint32_t>& RefDistances::GetOrder()
+{
+  if (!_sorted) Sort();
+  return _order;
+}
+
+void RefDistances::Sort()
+{
+  // Squared distances are never negative, so their bit patterns sort
+  // like the values. That allows a radix sort, 11 bits per pass.
+  const unsigned bits = 11, buckets = 1 << bits;
+  size_t count = _dist2.size();
+  std::vector<uint64_t> keys(count), temp(count);
+  for (size_t n = 0; n < count; n++) {
+    uint32_t key;
+    memcpy(&key, &_dist2[n], sizeof(key));
+    keys[n] = (uint64_t)key << 32 | n;
+  }
+  for (unsigned shift = 32; shift < 64; shift += bits) {
+    size_t start[buckets] = {};
+    for (uint64_t key : keys) {
+      start[(key >> shift) & (buckets - 1)]++;
+    }
+    size_t sum = 0;
+    for (unsigned b = 0; b < buckets; b++) {
+      size_t c = start[b];
+      start[b] = sum;
+      sum += c;
+    }
+    for (uint64_t key : keys) {
+      temp[start[(key >> shift) & (buckets - 1)]++] = key;
+    }
+    keys.swap(temp);
+  }
+
+  _order.resize(count);
+  for (size_t n = 0; n < count; n++) {
+    _order[n] = (uint32_t)keys[n];
+  }
+  _sorted = true;
+}
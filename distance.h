@@ -0,0 +1,42 @@
+#ifndef STARMAP_DISTANCE_H
+#define STARMAP_DISTANCE_H
+
+#include "maths.h"
+#include <cstdint>
+#include <vector>
+
+class Star;
+
+// Distances of all stars in the star list from one reference point,
+// indexed by Star::id, and the star list in order of that distance.
+// Update() is one vectorized pass over the star columns, cheap enough
+// to repeat whenever the reference changes; the order is only sorted
+// when someone asks for it.
+
+class RefDistances {
+public:
+  RefDistances(): _valid(false), _sorted(false) {}
+
+  void Clear();
+  // recompute for ref, unless that's what we already have
+  void Update(const Vector& ref);
+  bool IsValid() const { return _valid; }
+  size_t Size() const { return _dist2.size(); }
+
+  // distance of the star in parsecs, or NaN if unknown
+  float Get(const Star *star) const;
+  // star ids, nearest first
+  const std::vector<uint32_t>& GetOrder();
+
+protected:
+  bool _valid, _sorted;
+  double _ref[3];
+  std::vector<float> _dist2; // squared, which sorts the same
+  std::vector<uint32_t> _order;
+
+  void Sort();
+};
+
+extern RefDistances ref_distances;
+
+#endif //STARMAP_DISTANCE_H
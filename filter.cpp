@@ -0,0 +1,119 @@
+#include "filter.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <bitset>
+
+StarColumns star_columns;
+static const bool cleared = on_index_stars([]() { star_columns.Clear(); });
+
+SpectralClass spectral_class(const wxString& type)
+{
+  static const wxChar letters[] = wxT("OBAFGKMD");
+  // skip luminosity class prefixes such as "sd" or "k"
+  for (size_t n = 0; n < type.length(); n++) {
+    wxChar c = type[n];
+    if (c >= wxT('a') && c <= wxT('z')) continue;
+    for (unsigned cls = 0; cls < SPECTRAL_OTHER; cls++) {
+      if (c == letters[cls]) return (SpectralClass)cls;
+    }
+    break;
+  }
+  return SPECTRAL_OTHER;
+}
+
+wxString spectral_class_name(SpectralClass cls)
+{
+  static const wxChar letters[] = wxT("OBAFGKMD");
+  if (cls < SPECTRAL_OTHER) return wxString(letters[cls]);
+  return wxT("Other");
+}
+
+bool StarColumns::IsBuilt() const
+{
+  return mag.size() == star_table.size();
+}
+
+void StarColumns::Clear()
+{
+  x.clear();
+  y.clear();
+  z.clear();
+  mag.clear();
+  temp.clear();
+  cls.clear();
+  catalogs.clear();
+}
+
+void StarColumns::Build()
+{
+  size_t count = star_table.size();
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  mag.resize(count);
+  temp.resize(count);
+  cls.resize(count);
+  catalogs.resize(count);
+  parallel_for(count, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      const Star *star = star_table[n];
+      double px, py, pz;
+      star->get_pos().get(px, py, pz);
+      x[n] = (float)px;
+      y[n] = (float)py;
+      z[n] = (float)pz;
+      mag[n] = (float)star->vmag;
+      temp[n] = star->temp > 0.0 ? (float)star->temp : NAN;
+      cls[n] = (uint8_t)spectral_class(star->type);
+      catalogs[n] = star->catalogs;
+    }
+  });
+}
+
+void StarSelection::Apply(const StarFilter& filter)
+{
+  if (!star_columns.IsBuilt()) star_columns.Build();
+  const StarColumns& col = star_columns;
+  _size = col.Size();
+  _bits.assign((_size + 63) / 64, 0);
+
+  const float min_mag = (float)filter.min_mag, max_mag = (float)filter.max_mag;
+  const float min_temp = (float)filter.min_temp, max_temp = (float)filter.max_temp;
+  const bool any_mag = std::isinf(filter.min_mag) && std::isinf(filter.max_mag);
+  const bool any_temp = std::isinf(filter.min_temp) && std::isinf(filter.max_temp);
+  const float rx = (float)filter.ref.get_x(), ry = (float)filter.ref.get_y(),
+              rz = (float)filter.ref.get_z();
+  const float max_d2 = (float)(filter.max_dist * filter.max_dist);
+  const uint32_t classes = filter.classes, catalogs = filter.catalogs;
+
+  // Each word of the bitmap is computed from one run of 64 stars, without
+  // branches, so the compiler can vectorize the comparisons.
+  parallel_for(_bits.size(), [&](size_t begin, size_t end) {
+    for (size_t w = begin; w < end; w++) {
+      size_t base = w * 64;
+      size_t count = std::min((size_t)64, _size - base);
+      uint64_t word = 0;
+      for (size_t i = 0; i < count; i++) {
+        size_t n = base + i;
+        float dx = col.x[n] - rx, dy = col.y[n] - ry, dz = col.z[n] - rz;
+        bool keep = ((col.mag[n] >= min_mag) & (col.mag[n] <= max_mag)) | any_mag;
+        keep &= ((col.temp[n] >= min_temp) & (col.temp[n] <= max_temp)) | any_temp;
+        keep &= dx * dx + dy * dy + dz * dz <= max_d2;
+        keep &= ((classes >> col.cls[n]) & 1) != 0;
+        keep &= (col.catalogs[n] & catalogs) != 0;
+        word |= (uint64_t)keep << i;
+      }
+      _bits[w] = word;
+    }
+  }, 256);
+}
+
+size_t StarSelection::Count() const
+{
+  size_t count = 0;
+  for (uint64_t word : _bits) {
+    count += std::bitset<64>(word).count();
+  }
+  return count;
+}
@@ -0,0 +1,68 @@
+#ifndef STARMAP_FILTER_H
+#define STARMAP_FILTER_H
+
+#include "maths.h"
+#include <cstdint>
+#include <vector>
+#include <wx/string.h>
+
+// spectral classes a filter can select
+enum SpectralClass {
+  SPECTRAL_O, SPECTRAL_B, SPECTRAL_A, SPECTRAL_F, SPECTRAL_G, SPECTRAL_K, SPECTRAL_M,
+  SPECTRAL_D,     // white dwarfs
+  SPECTRAL_OTHER, // anything else, or unknown
+  SPECTRAL_CLASSES
+};
+
+SpectralClass spectral_class(const wxString& type);
+wxString spectral_class_name(SpectralClass cls);
+
+// Which stars to show. Stars whose magnitude or temperature is unknown
+// only pass if that range is unlimited.
+struct StarFilter {
+  unsigned classes = (1u << SPECTRAL_CLASSES) - 1; // bitmask of SpectralClass
+  unsigned catalogs = ~0u;  // stars found in any of these catalogs
+  double min_mag = -INFINITY, max_mag = INFINITY;   // absolute magnitude
+  double min_temp = -INFINITY, max_temp = INFINITY; // kelvin
+  Vector ref;               // reference point for max_dist
+  double max_dist = INFINITY;                       // parsecs
+};
+
+// The attributes that can be filtered on, one array per attribute,
+// indexed by Star::id. Built on first use, and kept until the star list
+// changes.
+class StarColumns {
+public:
+  void Clear();
+  bool IsBuilt() const;
+  void Build();
+  size_t Size() const { return mag.size(); }
+
+  std::vector<float> x, y, z;
+  std::vector<float> mag, temp;
+  std::vector<uint8_t> cls;
+  std::vector<uint32_t> catalogs;
+};
+
+extern StarColumns star_columns;
+
+// A bitmap with one bit per star in the star list.
+class StarSelection {
+public:
+  StarSelection(): _size(0) {}
+
+  // select the stars that pass filter
+  void Apply(const StarFilter& filter);
+
+  bool IsSelected(unsigned id) const {
+    return id < _size && ((_bits[id >> 6] >> (id & 63)) & 1);
+  }
+  size_t Count() const;
+  size_t Size() const { return _size; }
+
+protected:
+  std::vector<uint64_t> _bits;
+  size_t _size;
+};
+
+#endif //STARMAP_FILTER_H
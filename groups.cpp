@@ -0,0 +1,115 @@
+#include "groups.h"
+#include "disjoint.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <map>
+
+// km/s to parsecs/year, see ReadBase::Calculate
+#define KMS_PER_PCYR 977812.2999621
+
+MovingGroups moving_groups;
+static const bool cleared = on_index_stars([]() { moving_groups.Clear(); });
+
+void MovingGroups::Clear()
+{
+  _group_of.clear();
+  _groups.clear();
+}
+
+int MovingGroups::GetGroup(const Star *star) const
+{
+  if (!star->is3d || star->id >= _group_of.size()) return -1;
+  return _group_of[star->id];
+}
+
+void MovingGroups::Find(const GroupOptions& options)
+{
+  size_t count = star_table.size();
+  double r2 = options.radius * options.radius;
+  double speed = options.speed / KMS_PER_PCYR;
+  double s2 = speed * speed;
+
+  // Call fn(id) for each neighbour of star in position-velocity space.
+  // Any neighbour lies within the spatial radius, so the k-d tree
+  // narrows down the candidates. Only the part of the velocity across
+  // the line of sight (to the pair's midpoint) counts, as that's all
+  // that is known for stars without a radial velocity.
+  auto neighbours = [&](const Star *star, auto fn) {
+    star_index.ForEachInRadius(star->get_pos(), options.radius,
+                               [&](const StarIndex::Entry& entry, double d2) {
+      const Star *other = entry.star;
+      if (!other->has_motion) return;
+      Vector dv = other->motion - star->motion;
+      Vector sight = other->pos + star->pos;
+      double t2 = sight.sqr() > 0.0 ? Vector(dv, sight).sqr() / sight.sqr() : dv.sqr();
+      if (d2 / r2 + t2 / s2 <= 1.0) fn(other->id);
+    });
+  };
+
+  // find the core stars
+  std::vector<char> core(count, 0);
+  parallel_for(count, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      const Star *star = star_table[n];
+      if (!star->has_motion) continue;
+      unsigned found = 0;
+      neighbours(star, [&](unsigned) { found++; });
+      core[n] = found >= options.min_stars;
+    }
+  }, 256);
+
+  // Connect core stars that are neighbours, and attach each border star
+  // to its lowest-numbered core neighbour, so the result is the same
+  // regardless of scheduling.
+  disjoint_sets sets(count);
+  std::vector<size_t> border(count, SIZE_MAX);
+  parallel_for(count, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      const Star *star = star_table[n];
+      if (!star->has_motion) continue;
+      neighbours(star, [&](unsigned m) {
+        if (!core[m]) return;
+        if (core[n]) {
+          if (m < n) sets.unite(n, m);
+        } else if (m < border[n]) {
+          border[n] = m;
+        }
+      });
+    }
+  }, 256);
+
+  // number the groups, biggest first
+  std::map<size_t, std::vector<size_t>> by_root;
+  for (size_t n = 0; n < count; n++) {
+    if (core[n]) by_root[sets.find(n)].push_back(n);
+    else if (border[n] != SIZE_MAX) by_root[sets.find(border[n])].push_back(n);
+  }
+  std::vector<const std::vector<size_t>*> order;
+  for (const auto& it : by_root) {
+    order.push_back(&it.second);
+  }
+  std::stable_sort(order.begin(), order.end(), [](const std::vector<size_t> *a,
+                                                  const std::vector<size_t> *b) {
+    return a->size() > b->size();
+  });
+
+  _group_of.assign(count, -1);
+  _groups.assign(order.size(), Group());
+  for (size_t g = 0; g < order.size(); g++) {
+    Group& group = _groups[g];
+    for (size_t n : *order[g]) {
+      const Star *star = star_table[n];
+      _group_of[n] = (int)g;
+      group.members.push_back(star);
+      group.center += star->pos;
+      group.motion += star->motion;
+    }
+    group.center /= group.members.size();
+    group.motion /= group.members.size();
+    std::stable_sort(group.members.begin(), group.members.end(), [](const Star *a, const Star *b) {
+      return a->vmag < b->vmag;
+    });
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef STARMAP_GROUPS_H
+#define STARMAP_GROUPS_H
+
+#include "maths.h"
+#include <vector>
+
+class Star;
+
+struct GroupOptions {
+  double radius = 5.0;    // parsecs
+  double speed = 3.0;     // km/s
+  unsigned min_stars = 5; // neighbours (including itself) a core star needs
+};
+
+// Moving groups: clusters of stars that are close together and also move
+// the same way. Found by DBSCAN, where two stars are neighbours if their
+// separation in space and in velocity, each scaled by the options, adds up
+// to at most 1. Only stars with known motion take part, and as many of
+// them have no radial velocity, only tangential velocities are compared
+// (across the line of sight to the midpoint between the two stars).
+
+class MovingGroups {
+public:
+  struct Group {
+    std::vector<const Star*> members; // brightest first
+    Vector center;                    // mean position
+    Vector motion;                    // mean motion (parsecs/year)
+  };
+
+  void Clear();
+  bool IsBuilt() const { return !_group_of.empty(); }
+  void Find(const GroupOptions& options);
+
+  // groups in order of decreasing size
+  const std::vector<Group>& GetGroups() const { return _groups; }
+  // index of the group star belongs to, or -1
+  int GetGroup(const Star *star) const;
+
+protected:
+  std::vector<int> _group_of; // by Star::id
+  std::vector<Group> _groups;
+};
+
+extern MovingGroups moving_groups;
+
+#endif //STARMAP_GROUPS_H
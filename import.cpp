@@ -1,7 +1,13 @@
 #include "import.h"
+#include "crossmatch.h"
 #include "readbright.h"
 #include "readgliese.h"
+#include "disjoint.h"
+#include "neighbours.h"
+#include "parallel.h"
+#include <algorithm>
 #include <boost/range/adaptor/reversed.hpp>
+#include <unordered_set>
 #include <vector>
 #include <wx/log.h>
 
@@ -20,7 +26,25 @@ public:
 WX_DECLARE_STRING_HASH_MAP(starcomp*, starnamemap);
 starnamemap starnames;
 
-static Star* check_name_conflict(Star *star, const wxString& name, int ncomp)
+// first record carrying each designation, used by the bulk merge
+WX_DECLARE_STRING_HASH_MAP(size_t, firstmap);
+
+// catalogs imported so far, by their bit in Star::catalogs
+static std::vector<wxString> catalog_names;
+
+// A star that was placed in one of the star lists, tagged with the sequence
+// number of the record that put it there. The bulk merge uses this to
+// restore the order that a serial merge would have produced.
+struct placed_star {
+  size_t seq;
+  Star *star;
+  bool is3d; // whether it goes in the 3D list or the direction-only list
+
+  bool operator<(const placed_star& other) const { return seq < other.seq; }
+};
+typedef std::vector<placed_star> placed_list;
+
+static Star* check_name_conflict(starnamemap& names, Star *star, const wxString& name, int ncomp)
 {
   // Check whether the name to merge is already registered elsewhere.
   // For example, the Bright Star Catalog has the name "DY Eridani"
@@ -28,8 +52,8 @@ static Star* check_name_conflict(Star *star, const wxString& name, int ncomp)
   // Gliese correctly lists "DY Eridani" as a separate star.
   // In this case, assuming we've loaded Gliese first, we want to
   // prevent such a merge of the name "DY Eridani".
-  starnamemap::iterator it = starnames.find(name);
-  if (it == starnames.end()) return nullptr;
+  starnamemap::iterator it = names.find(name);
+  if (it == names.end()) return nullptr;
   starcomp *comp = it->second;
   if (ncomp > 0) {
     if (comp->comp.size() >= ncomp && comp->comp[ncomp - 1] && comp->comp[ncomp - 1] != star) {
@@ -56,15 +80,15 @@ static Star* check_name_conflict(Star *star, const wxString& name, int ncomp)
   return nullptr;
 }
 
-static void register_name(Star *star, const wxString& name, int ncomp)
+static void register_name(starnamemap& names, Star *star, const wxString& name, int ncomp)
 {
-  starnamemap::iterator it = starnames.find(name);
+  starnamemap::iterator it = names.find(name);
   starcomp *comp;
-  if (it != starnames.end()) {
+  if (it != names.end()) {
     comp = it->second;
   } else {
     comp = new starcomp;
-    starnames[name] = comp;
+    names[name] = comp;
   }
   if (ncomp > 0) {
     if (comp->comp.size() < ncomp) {
@@ -76,31 +100,29 @@ static void register_name(Star *star, const wxString& name, int ncomp)
   }
 }
 
-static void add_star(Star *star)
+static void add_star(starnamemap& names, placed_list& placed, Star *star, size_t seq)
 {
-  if (star->is3d) {
-    stars.push_back(star);
-  }
+  placed.push_back({seq, star, star->is3d});
 
   for (const auto& nit : star->names) {
-    register_name(star, nit.name, star->comp);
+    register_name(names, star, nit.name, star->comp);
   }
 }
 
-static void merge_names(Star *star, std::list<StarName> &dat, int comp)
+static void merge_names(starnamemap& names, Star *star, std::list<StarName> &dat, int comp)
 {
   auto nit = dat.begin();
   while (nit != dat.end()) {
     auto cit = nit;
     nit++;
-    Star* conflict = check_name_conflict(star, cit->name, comp);
+    Star* conflict = check_name_conflict(names, star, cit->name, comp);
     if (conflict) {
       wxLogVerbose(wxT("Star %s won't merge name %s due to conflict with %s"),
                    star->names.front().name, cit->name, conflict->names.front().name);
       continue;
     }
     // register the name anew in case the component is different
-    register_name(star, cit->name, comp);
+    register_name(names, star, cit->name, comp);
     // check whether we already have the name
     if (!star->has_name(cit->name)) {
       // nope, so merge it
@@ -111,7 +133,7 @@ static void merge_names(Star *star, std::list<StarName> &dat, int comp)
   star->sort_names();
 }
 
-static Star* find_merge_candidate(Star *star, int priority = -1)
+static Star* find_merge_candidate(starnamemap& names, Star *star, int priority = -1)
 {
   bool problem = false;
   // Iterate through names in reverse order because, although we
@@ -119,8 +141,8 @@ static Star* find_merge_candidate(Star *star, int priority = -1)
   // they tend to be the worst at distinguishing double/triple stars.
   for (const auto& nit : boost::adaptors::reverse(star->names)) {
     if (priority != -1 && nit.priority != priority) continue;
-    starnamemap::iterator it = starnames.find(nit.name);
-    if (it != starnames.end()) {
+    starnamemap::iterator it = names.find(nit.name);
+    if (it != names.end()) {
       starcomp *comp = it->second;
       Star *cstar;
       // in several common naming systems, the component stars of a binary star system
@@ -191,13 +213,54 @@ static Star* find_merge_candidate(Star *star, int priority = -1)
   return nullptr;
 }
 
-static bool merge_star(Star *star)
+// Merge the data of star into cstar. Returns true if this made cstar a 3D star.
+static bool absorb_star(starnamemap& names, Star *cstar, Star *star)
+{
+  merge_names(names, cstar, star->names, star->comp);
+  if (!star->remarks.IsEmpty()) {
+    if (!cstar->remarks.IsEmpty()) cstar->remarks += wxT(' ');
+    cstar->remarks += star->remarks;
+  }
+  cstar->catalogs |= star->catalogs;
+  if (!cstar->comp && star->comp) {
+    // merging the component might help the UI display
+    // binary systems without too much overlapping text
+    cstar->comp = star->comp;
+  }
+  if (!cstar->is3d && star->is3d) {
+#if 0
+    wxLogVerbose(wxT("Converting star %s to 3D"), star->names.front().name);
+#endif
+    cstar->is3d = star->is3d;
+    cstar->pos = star->pos;
+    cstar->motion = star->motion;
+    cstar->epoch = star->epoch;
+    cstar->has_motion = star->has_motion;
+    cstar->vmag = star->vmag;
+    cstar->color = star->color;
+    // Not sure if it makes sense to also overwrite type and temp,
+    // but we'll do it for consistency, because the type and temp
+    // of the merged star is currently used for the merged color.
+    // Maybe we'll want to change that later.
+    cstar->type = star->type;
+    cstar->temp = star->temp;
+    return true;
+  }
+  if (!cstar->has_motion && star->has_motion && cstar->is3d == star->is3d) {
+    cstar->motion = star->motion;
+    cstar->epoch = star->epoch;
+    cstar->has_motion = true;
+  }
+  return false;
+}
+
+static bool merge_star(starnamemap& names, placed_list& placed, Star *star, size_t seq)
 {
   // Start by trying to match relatively reliable naming systems...
-  Star* cstar = find_merge_candidate(star, ReadBase::PRI_HD);
+  Star* cstar = find_merge_candidate(names, star, ReadBase::PRI_HD);
   if (!cstar) {
     // If that fails, fall back to other systems
-    cstar = find_merge_candidate(star);
+    cstar = find_merge_candidate(names, star);
   }
   if (cstar) {
     // found match, merge
@@ -206,40 +269,103 @@ static bool merge_star(Star *star)
                  cstar->names.front().name, star->names.front().name,
                  nit.name);
 #endif
-    merge_names(cstar, star->names, star->comp);
-    if (!star->remarks.IsEmpty()) {
-      if (!cstar->remarks.IsEmpty()) cstar->remarks += wxT(' ');
-      cstar->remarks += star->remarks;
-    }
-    if (!cstar->comp && star->comp) {
-      // merging the component might help the UI display
-      // binary systems without too much overlapping text
-      cstar->comp = star->comp;
-    }
-    if (!cstar->is3d && star->is3d) {
-#if 0
-      wxLogVerbose(wxT("Converting star %s to 3D"), star->names.front().name);
-#endif
-      cstar->is3d = star->is3d;
-      cstar->pos = star->pos;
-      cstar->vmag = star->vmag;
-      cstar->color = star->color;
-      // Not sure if it makes sense to also overwrite type and temp,
-      // but we'll do it for consistency, because the type and temp
-      // of the merged star is currently used for the merged color.
-      // Maybe we'll want to change that later.
-      cstar->type = star->type;
-      cstar->temp = star->temp;
-      stars.push_back(cstar);
+    if (absorb_star(names, cstar, star)) {
+      placed.push_back({seq, cstar, true});
     }
     delete star;
     return true;
   }
   // not found, consider it a new star
-  add_star(star);
+  add_star(names, placed, star, seq);
   return false;
 }
 
+// Place the merged stars in the star lists. Stars that were first added
+// without a position, but got one from a later record, end up in both
+// lists, so weed those out of the direction-only list.
+static void place_stars(const placed_list& placed)
+{
+  for (const auto& it : placed) {
+    if (it.is3d) {
+      stars.push_back(it.star);
+    } else {
+      dir_stars.push_back(it.star);
+    }
+  }
+  dir_stars.remove_if([](const Star *star) { return star->is3d; });
+}
+
+void merge_duplicates(const std::vector<std::pair<Star*, Star*>>& pairs)
+{
+  std::unordered_set<const Star*> dups;
+  for (const auto& pair : pairs) {
+    Star *star = pair.first, *dup = pair.second;
+    // Point the duplicate's registrations at the surviving star first,
+    // so that its names don't look like conflicts when merged.
+    for (const auto& nit : dup->names) {
+      starnamemap::iterator it = starnames.find(nit.name);
+      if (it == starnames.end()) continue;
+      starcomp *comp = it->second;
+      if (comp->main == dup) comp->main = star;
+      for (Star*& c : comp->comp) {
+        if (c == dup) c = star;
+      }
+    }
+    if (absorb_star(starnames, star, dup)) {
+      stars.push_back(star);
+    }
+    dups.insert(dup);
+  }
+
+  auto is_dup = [&](const Star *star) { return dups.count(star) != 0; };
+  stars.remove_if(is_dup);
+  dir_stars.remove_if([&](const Star *star) { return star->is3d || is_dup(star); });
+  for (const Star *dup : dups) {
+    delete dup;
+  }
+}
+
+static Star* make_star(const ReadBase::StarData& data, unsigned catalog)
+{
+  float mag_factor = (float)((min_vmag - data.vmag) / (min_vmag - max_vmag));
+  mag_factor = std::max(mag_factor, 0.0f) * (1.0f - min_factor) + min_factor;
+
+  // Copy data to final data structure
+  Star* star = new Star;
+  star->is3d = data.is3d;
+  star->pos = data.position;
+  star->motion = data.motion;
+  star->epoch = data.epoch;
+  star->has_motion = data.has_motion;
+  star->vmag = data.vmag;
+  star->type = data.spectral_type;
+  star->temp = data.temperature;
+  star->color = (data.color * mag_factor).ToDisplay();
+  star->remarks = data.remarks;
+  star->catalogs = 1u << catalog;
+
+  if (!data.components.IsEmpty()) {
+    wxChar comp = data.components[0];
+    star->comp = (comp >= wxT('A')) ? (comp - wxT('A') + 1) : 0;
+  } else {
+    star->comp = 0;
+  }
+  star->names.push_back(data.name);
+  for (const auto& name : data.other_names) {
+    star->names.push_back(name);
+  }
+  star->sort_names();
+  return star;
+}
+
+static void read_catalog(ReadBase& importer, unsigned catalog, std::vector<Star*>& records)
+{
+  ReadBase::StarData data;
+  while (importer.ReadNext(data)) {
+    records.push_back(make_star(data, catalog));
+  }
+}
+
 void import_catalog(ReadBase& importer) {
   if (!importer.IsOk()) {
     return;
@@ -247,45 +373,184 @@ void import_catalog(ReadBase& importer) {
 
   wxLogVerbose(wxT("Loading %s..."), importer.GetCatalogName());
 
+  unsigned catalog = catalog_names.size();
+  catalog_names.push_back(importer.GetCatalogName());
+  placed_list placed;
   ReadBase::StarData data;
   while (importer.ReadNext(data)) {
-    float mag_factor = (float)((min_vmag - data.vmag) / (min_vmag - max_vmag));
-    mag_factor = std::max(mag_factor, 0.0f) * (1.0f - min_factor) + min_factor;
-
-    // Copy data to final data structure
-    Star* star = new Star;
-    star->is3d = data.is3d;
-    star->pos = data.position;
-    star->vmag = data.vmag;
-    star->type = data.spectral_type;
-    star->temp = data.temperature;
-    star->color = (data.color * mag_factor).ToDisplay();
-    star->remarks = data.remarks;
-
-    if (!data.components.IsEmpty()) {
-      wxChar comp = data.components[0];
-      star->comp = (comp >= wxT('A')) ? (comp - wxT('A') + 1) : 0;
-    } else {
-      star->comp = 0;
+    merge_star(starnames, placed, make_star(data, catalog), 0);
+  }
+  place_stars(placed);
+}
+
+void import_catalogs(const std::vector<ReadBase*>& importers) {
+  if (!starnames.empty()) {
+    // The bulk merge relies on seeing every record at once, so if
+    // something has already been imported, merge the serial way.
+    for (ReadBase* importer : importers) {
+      import_catalog(*importer);
     }
-    star->names.push_back(data.name);
-    for (const auto& name : data.other_names) {
-      star->names.push_back(name);
+    return;
+  }
+
+  // Parse all catalogs concurrently.
+  unsigned first_catalog = catalog_names.size();
+  for (ReadBase* importer : importers) {
+    catalog_names.push_back(importer->GetCatalogName());
+  }
+  std::vector<std::vector<Star*>> loaded(importers.size());
+  parallel_for(importers.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      if (!importers[n]->IsOk()) continue;
+      wxLogVerbose(wxT("Loading %s..."), importers[n]->GetCatalogName());
+      read_catalog(*importers[n], first_catalog + n, loaded[n]);
     }
-    star->sort_names();
+  }, 1);
 
-    merge_star(star);
+  // Concatenate in catalog order; a record's index is its sequence number,
+  // i.e. the order in which the serial merge would have seen it.
+  std::vector<Star*> records;
+  for (auto& cat : loaded) {
+    records.insert(records.end(), cat.begin(), cat.end());
+    cat.clear();
   }
-}
 
-void import_all() {
+  // Build the designation -> record index. Each chunk of records first
+  // sorts its designations into shards by hash, then each shard is
+  // resolved on its own, uniting all records that share a designation.
+  // Records that never share a designation with each other can't affect
+  // each other's merge, so each resulting set can be merged independently.
+  const size_t grain = 4096;
+  const size_t shards = 64;
+  size_t chunks = (records.size() + grain - 1) / grain;
+  typedef std::vector<std::pair<const wxString*, size_t>> shard_entries;
+  std::vector<shard_entries> sharded(chunks * shards);
+  parallel_for(records.size(), [&](size_t begin, size_t end) {
+    shard_entries* out = &sharded[begin / grain * shards];
+    wxStringHash hash;
+    for (size_t n = begin; n < end; n++) {
+      for (const auto& nit : records[n]->names) {
+        out[hash(nit.name) % shards].emplace_back(&nit.name, n);
+      }
+    }
+  }, grain);
+
+  disjoint_sets sets(records.size());
+  parallel_for(shards, [&](size_t begin, size_t end) {
+    for (size_t shard = begin; shard < end; shard++) {
+      firstmap first;
+      for (size_t chunk = 0; chunk < chunks; chunk++) {
+        for (const auto& entry : sharded[chunk * shards + shard]) {
+          auto ins = first.insert(firstmap::value_type(*entry.first, entry.second));
+          if (!ins.second) sets.unite(ins.first->second, entry.second);
+        }
+      }
+    }
+  }, 1);
+  sharded.clear();
+
+  // Group records by set, keeping each group in sequence order.
+  std::vector<std::vector<size_t>> groups;
   {
-    ReadGliese catalog(wxT("gliese"));
-    import_catalog(catalog);
+    std::vector<size_t> group_of(records.size());
+    for (size_t n = 0; n < records.size(); n++) {
+      size_t root = sets.find(n);
+      if (root == n) {
+        group_of[n] = groups.size();
+        groups.emplace_back();
+      } else {
+        group_of[n] = group_of[root];
+      }
+      groups[group_of[n]].push_back(n);
+    }
   }
-  {
-    ReadBright catalog(wxT("bright"));
-    import_catalog(catalog);
+
+  // Materialise each group with exactly the same merge logic as the
+  // serial import, just against a name table of its own.
+  std::vector<starnamemap> group_names(groups.size());
+  std::vector<placed_list> group_placed(groups.size());
+  parallel_for(groups.size(), [&](size_t begin, size_t end) {
+    for (size_t g = begin; g < end; g++) {
+      for (size_t n : groups[g]) {
+        merge_star(group_names[g], group_placed[g], records[n], n);
+      }
+    }
+  }, 64);
+
+  // Stitch the results together. Names never occur in more than one
+  // group, so the name tables can simply be combined.
+  placed_list placed;
+  for (size_t g = 0; g < groups.size(); g++) {
+    for (auto& it : group_names[g]) {
+      starnames[it.first] = it.second;
+    }
+    placed.insert(placed.end(), group_placed[g].begin(), group_placed[g].end());
+  }
+  std::sort(placed.begin(), placed.end());
+  place_stars(placed);
+}
+
+void import_all(bool crossmatch) {
+  ReadGliese gliese(wxT("gliese"));
+  ReadBright bright(wxT("bright"));
+  import_catalogs({&gliese, &bright});
+  if (crossmatch) {
+    crossmatch_stars(CrossMatchOptions());
   }
+  index_stars();
+  neighbour_graph.Build(MAX_NEIGHBOURS);
   wxLogVerbose(wxT("Loaded %zu stars."), stars.size());
 }
+
+std::vector<wxString> catalog_files() {
+  // as opened by ReadGliese and ReadBright
+  std::vector<wxString> files;
+  for (const auto& name : { wxFileName(wxT("gliese"), wxT("catalog.dat")),
+                            wxFileName(wxT("bright"), wxT("catalog")),
+                            wxFileName(wxT("bright"), wxT("notes")) }) {
+    files.push_back(name.GetFullPath());
+    files.push_back(name.GetFullPath() + wxT(".gz"));
+  }
+  return files;
+}
+
+void clear_imports() {
+  for (const auto list : { &stars, &dir_stars }) {
+    for (Star *star : *list) {
+      delete star;
+    }
+    list->clear();
+  }
+  // every name has a record of its own, even after the bulk merge
+  for (auto& it : starnames) {
+    delete it.second;
+  }
+  starnames.clear();
+  catalog_names.clear();
+}
+
+Star* find_star(const wxString& name) {
+  starnamemap::iterator it = starnames.find(name);
+  if (it == starnames.end()) return nullptr;
+  starcomp *comp = it->second;
+  if (comp->main) return comp->main;
+  for (Star *c : comp->comp) {
+    if (c) return c;
+  }
+  return nullptr;
+}
+
+const std::vector<wxString>& get_catalog_names() {
+  return catalog_names;
+}
+
+void adopt_stars(const std::vector<wxString>& catalogs) {
+  catalog_names = catalogs;
+  for (const auto list : { &stars, &dir_stars }) {
+    for (Star *star : *list) {
+      for (const auto& nit : star->names) {
+        register_name(starnames, star, nit.name, star->comp);
+      }
+    }
+  }
+}
@@ -1,10 +1,45 @@
 #ifndef STARMAP_IMPORT_H
 #define STARMAP_IMPORT_H
 
+#include <utility>
+#include <vector>
+#include <wx/string.h>
+
 class ReadBase;
+class Star;
 
 void import_catalog(ReadBase& importer);
 
-void import_all();
+// Bulk import of several catalogs at once. Parses, indexes and merges on
+// all available cores, but gives the same result as calling import_catalog
+// on each catalog in turn.
+void import_catalogs(const std::vector<ReadBase*>& importers);
+
+// Merge each pair's second star into its first, for duplicates found by
+// other means than their names. The duplicates are deleted.
+void merge_duplicates(const std::vector<std::pair<Star*, Star*>>& pairs);
+
+void import_all(bool crossmatch = false);
+
+// the files import_all() reads from, each plain and gzip-compressed
+// (only one of which is normally there)
+std::vector<wxString> catalog_files();
+
+// names of the imported catalogs, by their bit in Star::catalogs
+const std::vector<wxString>& get_catalog_names();
+
+// Take over star lists that were filled by other means than importing
+// (such as the cache), with the given catalog names, and register their
+// designations for find_star.
+void adopt_stars(const std::vector<wxString>& catalogs);
+
+// Forget everything imported or adopted so far: the stars are deleted,
+// and the catalog names and designations dropped. Call index_stars()
+// afterwards.
+void clear_imports();
+
+// Look up a star by one of its designations. For names shared by the
+// components of a system, the first component is returned.
+Star* find_star(const wxString& name);
 
 #endif //STARMAP_IMPORT_H
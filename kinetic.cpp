@@ -0,0 +1,65 @@
+#include "kinetic.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+
+KineticIndex kinetic_index;
+static const bool cleared = on_index_stars([]() { kinetic_index.Clear(); });
+
+void KineticIndex::Clear()
+{
+  StarIndex::Clear();
+  _motion.clear();
+  _speeds.clear();
+}
+
+void KineticIndex::Build(double base, double window)
+{
+  Clear();
+  _base = base;
+  _window = window;
+  Reserve(star_table.size());
+  for (Star *star : star_table) {
+    Add(star, star->pos + star->motion * (base - star->epoch));
+  }
+  StarIndex::Build();
+  BuildTiers();
+
+  // the tree shuffled the entries, so pick up their motion afterwards
+  _motion.resize(_entries.size());
+  parallel_for(_entries.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      _motion[n] = _entries[n].star->motion;
+    }
+  }, 16384);
+
+  // Children always come after their parent, so going backwards
+  // sees both children of a node before the node itself.
+  _speeds.resize(_nodes.size());
+  for (size_t index = _nodes.size(); index-- > 0; ) {
+    const Node& node = _nodes[index];
+    Speed& speed = _speeds[index];
+    if (node.left != no_node) {
+      const Speed& left = _speeds[node.left];
+      const Speed& right = _speeds[node.right];
+      for (unsigned a = 0; a < 3; a++) {
+        speed.lo[a] = std::min(left.lo[a], right.lo[a]);
+        speed.hi[a] = std::max(left.hi[a], right.hi[a]);
+      }
+      continue;
+    }
+    for (unsigned a = 0; a < 3; a++) {
+      speed.lo[a] = INFINITY;
+      speed.hi[a] = -INFINITY;
+    }
+    for (uint32_t n = node.begin; n < node.end; n++) {
+      double v[3];
+      _motion[n].get(v[0], v[1], v[2]);
+      for (unsigned a = 0; a < 3; a++) {
+        speed.lo[a] = std::min(speed.lo[a], v[a]);
+        speed.hi[a] = std::max(speed.hi[a], v[a]);
+      }
+    }
+  }
+}
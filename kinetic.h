@@ -0,0 +1,198 @@
+#ifndef STARMAP_KINETIC_H
+#define STARMAP_KINETIC_H
+
+#include "spatial.h"
+#include <cmath>
+
+// A k-d tree over the star list at a base epoch, where each node also
+// bounds the motion of the stars below it. Box queries for another epoch
+// grow each node's box by how far those stars can have moved, so they're
+// correct for any epoch, and about as fast as the static tree for epochs
+// near the base. Only rebuild (around a new base) once the epochs of
+// interest leave the window. The map's display epoch only affects the
+// display: the map culls (and so picks) through it when drawn at another
+// epoch, and the approach finder follows paths through its own one; the
+// neighbour, jump, reach, route, group and territory tools work on the
+// catalog positions and use the static index.
+
+class KineticIndex : public StarIndex {
+public:
+  KineticIndex(): _base(2000.0), _window(0.0) {}
+
+  void Clear();
+  // index the star list as of year base, for use within window years of it
+  void Build(double base, double window);
+  bool Covers(double epoch) const { return !_nodes.empty() && fabs(epoch - _base) <= _window; }
+
+  // call fn(entry, position at epoch) for each star inside the box [lo, hi]
+  // at epoch, optionally only in the subtree below root (see GetSubtrees)
+  template<typename F> void ForEachInBox(const Vector& lo, const Vector& hi, double epoch, F fn,
+                                         uint32_t root = 0) const;
+
+  // the same, but level of detail as in StarIndex::ForEachInBoxLOD
+  template<typename F> void ForEachInBoxLOD(const Vector& lo, const Vector& hi, double epoch,
+                                            double detail, F fn, uint32_t root = 0) const {
+    ForEachInBoxLOD(lo, hi, epoch, detail, fn, _tiers, [](const Star *) { return true; }, root);
+  }
+  template<typename F, typename A>
+  void ForEachInBoxLOD(const Vector& lo, const Vector& hi, double epoch, double detail, F fn,
+                       const Tiers& tiers, A accept, uint32_t root = 0) const;
+
+  // call fn(entry) for each star that may come within r of a point
+  // moving with velocity v, which is at c at epoch, at some time
+  // between epoch + t0 and epoch + t1 (each node bounds its own stars'
+  // paths, so slow regions are pruned however fast other stars move)
+  template<typename F> void ForEachNearPath(const Vector& c, const Vector& v, double epoch,
+                                            double r, double t0, double t1, F fn) const;
+
+protected:
+  struct Speed {
+    double lo[3], hi[3]; // parsecs per year
+  };
+
+  double _base, _window;
+  std::vector<Vector> _motion; // by entry
+  std::vector<Speed> _speeds;  // by node
+
+  // the node's box at base + dt
+  void NodeBox(uint32_t index, double dt, double lo[3], double hi[3]) const {
+    const Node& node = _nodes[index];
+    const Speed& speed = _speeds[index];
+    for (unsigned a = 0; a < 3; a++) {
+      double slow = speed.lo[a] * dt, fast = speed.hi[a] * dt;
+      lo[a] = node.lo[a] + std::min(slow, fast);
+      hi[a] = node.hi[a] + std::max(slow, fast);
+    }
+  }
+};
+
+extern KineticIndex kinetic_index;
+
+template<typename F>
+void KineticIndex::ForEachInBox(const Vector& lo, const Vector& hi, double epoch, F fn,
+                                uint32_t root) const
+{
+  if (_nodes.empty()) return;
+  double dt = epoch - _base;
+  double qlo[3], qhi[3];
+  lo.get(qlo[0], qlo[1], qlo[2]);
+  hi.get(qhi[0], qhi[1], qhi[2]);
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = root;
+  while (sp) {
+    uint32_t index = stack[--sp];
+    const Node& node = _nodes[index];
+    double blo[3], bhi[3];
+    NodeBox(index, dt, blo, bhi);
+    bool outside = false;
+    for (unsigned a = 0; a < 3; a++) {
+      if (bhi[a] < qlo[a] || blo[a] > qhi[a]) outside = true;
+    }
+    if (outside) continue;
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        Vector p = _entries[n].pos + _motion[n] * dt;
+        double x, y, z;
+        p.get(x, y, z);
+        if (x < qlo[0] || x > qhi[0] ||
+            y < qlo[1] || y > qhi[1] ||
+            z < qlo[2] || z > qhi[2]) continue;
+        fn(_entries[n], p);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+template<typename F, typename A>
+void KineticIndex::ForEachInBoxLOD(const Vector& lo, const Vector& hi, double epoch, double detail,
+                                   F fn, const Tiers& tiers, A accept, uint32_t root) const
+{
+  if (_nodes.empty()) return;
+  double dt = epoch - _base;
+  double qlo[3], qhi[3];
+  lo.get(qlo[0], qlo[1], qlo[2]);
+  hi.get(qhi[0], qhi[1], qhi[2]);
+  auto visit = [&](uint32_t n) {
+    Vector p = _entries[n].pos + _motion[n] * dt;
+    double x, y, z;
+    p.get(x, y, z);
+    if (x < qlo[0] || x > qhi[0] ||
+        y < qlo[1] || y > qhi[1] ||
+        z < qlo[2] || z > qhi[2]) return;
+    fn(_entries[n], p);
+  };
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = root;
+  while (sp) {
+    uint32_t index = stack[--sp];
+    const Node& node = _nodes[index];
+    double blo[3], bhi[3];
+    NodeBox(index, dt, blo, bhi);
+    bool outside = false;
+    for (unsigned a = 0; a < 3; a++) {
+      if (bhi[a] < qlo[a] || blo[a] > qhi[a]) outside = true;
+    }
+    if (outside) continue;
+    if (IsCoarse(tiers, blo, bhi, detail)) {
+      const uint32_t *tier = &tiers.entries[(size_t)index * tier_size];
+      for (uint32_t t = 0; t < tiers.counts[index]; t++) visit(tier[t]);
+      continue;
+    }
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        if (accept(_entries[n].star)) visit(n);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+template<typename F>
+void KineticIndex::ForEachNearPath(const Vector& c, const Vector& v, double epoch,
+                                   double r, double t0, double t1, F fn) const
+{
+  if (_nodes.empty()) return;
+  double d0 = epoch + t0 - _base, d1 = epoch + t1 - _base;
+  double qc[3], qv[3];
+  (c + v * (_base - epoch)).get(qc[0], qc[1], qc[2]);
+  v.get(qv[0], qv[1], qv[2]);
+  double r2 = r * r;
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    uint32_t index = stack[--sp];
+    const Node& node = _nodes[index];
+    const Speed& speed = _speeds[index];
+    // the box holding every offset from the point during the time span
+    double d2 = 0.0;
+    for (unsigned a = 0; a < 3; a++) {
+      double slow = speed.lo[a] - qv[a], fast = speed.hi[a] - qv[a];
+      double lo = node.lo[a] - qc[a] + std::min(std::min(slow * d0, slow * d1), std::min(fast * d0, fast * d1));
+      double hi = node.hi[a] - qc[a] + std::max(std::max(slow * d0, slow * d1), std::max(fast * d0, fast * d1));
+      double d = lo > 0.0 ? lo : hi < 0.0 ? -hi : 0.0;
+      d2 += d * d;
+    }
+    if (d2 > r2) continue;
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        fn(_entries[n]);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+#endif //STARMAP_KINETIC_H
@@ -0,0 +1,154 @@
+#include "labels.h"
+#include <algorithm>
+#include <wx/brush.h>
+#include <wx/dcmemory.h>
+
+const LabelCache::Label& LabelCache::Get(const Star *star, const wxString& text, const wxFont& font)
+{
+  auto found = _index.find(star);
+  if (found != _index.end()) {
+    Entries::iterator entry = found->second;
+    _entries.splice(_entries.begin(), _entries, entry);
+    Label& label = entry->second;
+    if (label.text != text) {
+      _bytes -= label.alpha.size();
+      label.text = text;
+      Rasterise(label, font);
+      _bytes += label.alpha.size();
+    }
+    return label;
+  }
+
+  _entries.emplace_front(star, Label());
+  Label& label = _entries.front().second;
+  label.text = text;
+  Rasterise(label, font);
+  _bytes += label.alpha.size();
+  _index[star] = _entries.begin();
+  return label;
+}
+
+void LabelCache::Trim()
+{
+  while (_bytes > _max_bytes && !_entries.empty()) {
+    const auto& entry = _entries.back();
+    _bytes -= entry.second.alpha.size();
+    _index.erase(entry.first);
+    _entries.pop_back();
+  }
+}
+
+void LabelCache::Clear()
+{
+  _entries.clear();
+  _index.clear();
+  _bytes = 0;
+}
+
+void LabelCache::Rasterise(Label& label, const wxFont& font)
+{
+  // draw the text white on black, and keep how much of each pixel it covers
+  wxMemoryDC mdc;
+  mdc.SetFont(font);
+  wxCoord w = 0, h = 0;
+  mdc.GetTextExtent(label.text, &w, &h);
+  label.width = w;
+  label.height = h;
+  label.alpha.assign((size_t)w * h, 0);
+  if (w <= 0 || h <= 0) return;
+
+  wxBitmap bitmap(w, h, 24);
+  mdc.SelectObject(bitmap);
+  mdc.SetBackground(*wxBLACK_BRUSH);
+  mdc.Clear();
+  mdc.SetBackgroundMode(wxTRANSPARENT);
+  mdc.SetTextForeground(*wxWHITE);
+  mdc.DrawText(label.text, 0, 0);
+  mdc.SelectObject(wxNullBitmap);
+
+  wxNativePixelData data(bitmap);
+  auto pixels = data.GetPixels();
+  for (int y = 0; y < h; y++) {
+    pixels.MoveTo(data, 0, y);
+    for (int x = 0; x < w; x++, ++pixels) {
+      // subpixel antialiasing gives each channel its own coverage;
+      // the labels are drawn in green, so go by that
+      label.alpha[(size_t)y * w + x] = pixels.Green();
+    }
+  }
+}
+
+void LabelCache::Draw(wxNativePixelData& data, const Label& label, int x, int y,
+                      const wxRect& clip, const wxColour& color)
+{
+  int x1 = std::max({x, clip.GetLeft(), 0});
+  int x2 = std::min({x + label.width, clip.GetRight() + 1, data.GetWidth()});
+  int y1 = std::max({y, clip.GetTop(), 0});
+  int y2 = std::min({y + label.height, clip.GetBottom() + 1, data.GetHeight()});
+  if (x1 >= x2 || y1 >= y2) return;
+
+  auto pixels = data.GetPixels();
+  for (int py = y1; py < y2; py++) {
+    const uint8_t *alpha = &label.alpha[(size_t)(py - y) * label.width + (x1 - x)];
+    pixels.MoveTo(data, x1, py);
+    for (int px = x1; px < x2; px++, alpha++, ++pixels) {
+      unsigned a = *alpha;
+      if (!a) continue;
+      pixels.Red()   = (pixels.Red()   * (255 - a) + color.Red()   * a) / 255;
+      pixels.Green() = (pixels.Green() * (255 - a) + color.Green() * a) / 255;
+      pixels.Blue()  = (pixels.Blue()  * (255 - a) + color.Blue()  * a) / 255;
+    }
+  }
+}
+
+const int LabelPlacer::cell;
+
+void LabelPlacer::Reset(int width, int height)
+{
+  _cols = width > 0 ? (width + cell - 1) / cell : 0;
+  _rows = height > 0 ? (height + cell - 1) / cell : 0;
+  _taken.assign((size_t)_cols * _rows, 0);
+}
+
+bool LabelPlacer::Cells(const wxRect& r, int& cx1, int& cy1, int& cx2, int& cy2) const
+{
+  if (r.IsEmpty()) return false;
+  cx1 = std::max(r.GetLeft(), 0) / cell;
+  cy1 = std::max(r.GetTop(), 0) / cell;
+  cx2 = r.GetRight() < 0 ? -1 : std::min(r.GetRight() / cell, _cols - 1);
+  cy2 = r.GetBottom() < 0 ? -1 : std::min(r.GetBottom() / cell, _rows - 1);
+  return cx1 <= cx2 && cy1 <= cy2;
+}
+
+void LabelPlacer::Occupy(const wxRect& r)
+{
+  int cx1, cy1, cx2, cy2;
+  if (!Cells(r, cx1, cy1, cx2, cy2)) return;
+  for (int cy = cy1; cy <= cy2; cy++) {
+    std::fill(&_taken[(size_t)cy * _cols + cx1], &_taken[(size_t)cy * _cols + cx2] + 1, 1);
+  }
+}
+
+bool LabelPlacer::IsFree(const wxRect& r) const
+{
+  int cx1, cy1, cx2, cy2;
+  if (!Cells(r, cx1, cy1, cx2, cy2)) return true;
+  for (int cy = cy1; cy <= cy2; cy++) {
+    const uint8_t *row = &_taken[(size_t)cy * _cols];
+    for (int cx = cx1; cx <= cx2; cx++) {
+      if (row[cx]) return false;
+    }
+  }
+  return true;
+}
+
+int LabelPlacer::Place(const wxRect *candidates, int count)
+{
+  for (int n = 0; n < count; n++) {
+    if (IsFree(candidates[n])) {
+      Occupy(candidates[n]);
+      return n;
+    }
+  }
+  return -1;
+}
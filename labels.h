@@ -0,0 +1,81 @@
+#ifndef STARMAP_LABELS_H
+#define STARMAP_LABELS_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <wx/colour.h>
+#include <wx/font.h>
+#include <wx/gdicmn.h>
+#include <wx/rawbmp.h>
+#include <wx/string.h>
+
+class Star;
+
+// Star names rasterised once and kept as coverage masks, so that
+// drawing a label only blends its pixels into the picture. Labels not
+// used for a while are dropped once the cache grows past its limit.
+
+class LabelCache {
+public:
+  struct Label {
+    wxString text;
+    int width, height;
+    std::vector<uint8_t> alpha; // coverage, row by row
+  };
+
+  LabelCache(size_t max_bytes): _bytes(0), _max_bytes(max_bytes) {}
+
+  // star's label showing text, rasterised with font if it's not cached
+  // (or showed something else); stays valid until the next Trim()
+  const Label& Get(const Star *star, const wxString& text, const wxFont& font);
+
+  // drop the least recently used labels until within the limit
+  void Trim();
+  void Clear();
+
+  // blend label into data with its top left corner at (x, y),
+  // leaving the pixels outside clip alone
+  static void Draw(wxNativePixelData& data, const Label& label, int x, int y,
+                   const wxRect& clip, const wxColour& color);
+
+protected:
+  typedef std::list<std::pair<const Star*, Label>> Entries;
+
+  Entries _entries; // most recently used first
+  std::unordered_map<const Star*, Entries::iterator> _index;
+  size_t _bytes, _max_bytes;
+
+  static void Rasterise(Label& label, const wxFont& font);
+};
+
+// Keeps labels from overlapping: each one takes the first of its
+// candidate positions whose cells on a coarse screen grid are still
+// free, or is dropped if none is. Parts off screen don't count.
+
+class LabelPlacer {
+public:
+  LabelPlacer(): _cols(0), _rows(0) {}
+
+  // forget all labels and set up for a new screen size
+  void Reset(int width, int height);
+
+  // mark the cells under r as taken
+  void Occupy(const wxRect& r);
+  bool IsFree(const wxRect& r) const;
+
+  // the index of the first free candidate, which is then taken, or -1
+  int Place(const wxRect *candidates, int count);
+
+protected:
+  static const int cell = 4; // pixels square
+
+  int _cols, _rows;
+  std::vector<uint8_t> _taken;
+
+  // the cells under r, clipped to the screen; false if none
+  bool Cells(const wxRect& r, int& cx1, int& cy1, int& cx2, int& cy2) const;
+};
+
+#endif //STARMAP_LABELS_H
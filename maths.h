@@ -4,6 +4,8 @@
 #include <cmath>
 #include <wx/gdicmn.h>
 
+#define LIGHTYEAR_PER_PARSEC 3.26
+
 class Angle
 {
 protected:
@@ -58,6 +60,12 @@ public:
     return wxPoint(s * _x / _z + xc, s * _y / _z + yc);
   }
 
+  // orthographic projection; rounds down before adding the (whole)
+  // screen offset, so that moving the offset moves the picture exactly
+  wxPoint oproject(double s, int xc, int yc) const {
+    return wxPoint(::floor(s * _x) + xc, ::floor(s * _y) + yc);
+  }
+
   double sqr() const {
     return _x*_x + _y*_y + _z*_z;
   }
@@ -169,6 +177,7 @@ protected:
   double _r[3][3]; // rotation
   double _t[3];    // translation
   friend class Vector;
+  friend class Projector;
 public:
   // identity transform
   Transform()
@@ -0,0 +1,50 @@
+#include "neighbours.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+
+NeighbourGraph neighbour_graph;
+static const bool cleared = on_index_stars([]() { neighbour_graph.Clear(); });
+
+void NeighbourGraph::Clear()
+{
+  _k = 0;
+  _links.clear();
+  _count.clear();
+}
+
+void NeighbourGraph::Build(size_t k)
+{
+  if (IsBuilt() && k <= _k) return;
+
+  size_t n = star_table.size();
+  _links.assign(n * k, Neighbour(0.0, nullptr));
+  _count.assign(n, 0);
+  parallel_for(n, [&](size_t begin, size_t end) {
+    std::vector<Neighbour> found;
+    for (size_t id = begin; id < end; id++) {
+      const Star *star = star_table[id];
+      star_index.Nearest(star->get_pos(), k, found, star);
+      std::copy(found.begin(), found.end(), _links.begin() + id * k);
+      _count[id] = (unsigned)found.size();
+    }
+  }, 256);
+  _k = k;
+}
+
+void NeighbourGraph::Adopt(size_t k, std::vector<Neighbour>& links, std::vector<unsigned>& count)
+{
+  _links.swap(links);
+  _count.swap(count);
+  _k = k;
+}
+
+void NeighbourGraph::Get(const Star *star, size_t count, std::vector<Neighbour>& out) const
+{
+  out.clear();
+  size_t id = star->id;
+  if (id >= _count.size() || star_table[id] != star) return;
+  count = std::min(count, std::min(_k, (size_t)_count[id]));
+  out.assign(_links.begin() + id * _k, _links.begin() + id * _k + count);
+}
@@ -0,0 +1,46 @@
+#ifndef STARMAP_NEIGHBOURS_H
+#define STARMAP_NEIGHBOURS_H
+
+#include "spatial.h"
+#include <vector>
+
+// longest neighbour list offered, and the number kept in the star cache
+#define MAX_NEIGHBOURS 50
+
+// The k nearest neighbours of every star in the star list. Built on
+// first use, using all cores, and kept until the star list changes.
+
+class NeighbourGraph {
+public:
+  typedef StarIndex::Neighbour Neighbour;
+
+  NeighbourGraph(): _k(0) {}
+
+  void Clear();
+  bool IsBuilt() const { return _k != 0; }
+  // Finds k neighbours for each star. import_all() builds the graph for
+  // MAX_NEIGHBOURS, and load_star_cache() reads it back (or builds it, if
+  // the cache has none), so that after loading the stars it's only read.
+  void Build(size_t k);
+
+  size_t GetK() const { return _k; }
+
+  // up to count (at most GetK()) nearest neighbours of star, closest first
+  void Get(const Star *star, size_t count, std::vector<Neighbour>& out) const;
+
+  // the stored lists, for the star cache: GetK() entries per star id,
+  // of which the first count[id] are valid
+  const std::vector<Neighbour>& GetLinks() const { return _links; }
+  const std::vector<unsigned>& GetCounts() const { return _count; }
+  // takes over lists laid out the same way, built for the current star list
+  void Adopt(size_t k, std::vector<Neighbour>& links, std::vector<unsigned>& count);
+
+protected:
+  size_t _k;
+  std::vector<Neighbour> _links; // _k entries per star, by Star::id
+  std::vector<unsigned> _count;  // number of valid entries per star
+};
+
+extern NeighbourGraph neighbour_graph;
+
+#endif //STARMAP_NEIGHBOURS_H
@@ -0,0 +1,697 @@
+#include "panels.h"
+#include "starmap.h"
+#include "starlist.h"
+#include "neighbours.h"
+#include "import.h"
+#include "route.h"
+#include "approach.h"
+#include "groups.h"
+#include "filter.h"
+#include "distance.h"
+#include <wx/msgdlg.h>
+#include <wx/sizer.h>
+#include <wx/stattext.h>
+#include <wx/stopwatch.h>
+
+#define PANEL_COUNT 1001
+#define PANEL_LIST  1002
+#define PANEL_PLAN  1003
+#define PANEL_CLEAR 1004
+#define PANEL_FIND  1005
+#define PANEL_QUERY 1006
+#define PANEL_FUZZY 1007
+
+// filter slider ranges; the slider ends mean "no limit"
+#define FILTER_MAG_MIN  -100 // tenths of a magnitude
+#define FILTER_MAG_MAX   200
+#define FILTER_TEMP_MAX  400 // hundreds of kelvin
+#define FILTER_DIST_MAX 2000 // light years
+
+// find a star with a position, by exact designation or else by substring
+static const Star *lookup_star(const wxString& name)
+{
+  const Star *star = find_star(name);
+  if (star && star->is3d) return star;
+  for (const auto st : star_table) {
+    for (const auto &nit : st->names) {
+      if (nit.name.Find(name) >= 0) return st;
+    }
+  }
+  return (const Star *)NULL;
+}
+
+SearchList::SearchList(wxWindow *parent, int id)
+  : wxListCtrl(parent, id, wxDefaultPosition, wxDefaultSize,
+               wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_VIRTUAL)
+{
+  InsertColumn(0, "Designation", wxLIST_FORMAT_LEFT, 150);
+  InsertColumn(1, "Star", wxLIST_FORMAT_LEFT, 150);
+  InsertColumn(2, "Distance", wxLIST_FORMAT_RIGHT, 80);
+}
+
+wxString SearchList::OnGetItemText(long item, long column) const
+{
+  if (!results || item < 0 || (size_t)item >= results->size()) return wxEmptyString;
+  const NameMatch& match = (*results)[item];
+  switch (column) {
+  case 0:
+    return *match.name;
+  case 1:
+    return star_label(match.star);
+  case 2:
+    if (match.star->is3d) {
+      return wxString::Format(wxT("%.2f ly"), match.star->pos.norm() * LIGHTYEAR_PER_PARSEC);
+    }
+    break;
+  }
+  return wxEmptyString;
+}
+
+SearchPanel::SearchPanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Search", wxDefaultPosition, wxSize(400, 440),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent),
+    current(0)
+{
+  query = new wxTextCtrl(this, PANEL_QUERY, wxEmptyString, wxDefaultPosition, wxDefaultSize,
+                         wxTE_PROCESS_ENTER);
+  query->SetHint("Star name");
+  fuzzy = new wxCheckBox(this, PANEL_FUZZY, "Fuzzy");
+  list = new SearchList(this, PANEL_LIST);
+
+  wxBoxSizer *top = new wxBoxSizer(wxHORIZONTAL);
+  top->Add(query, 1, wxALL | wxALIGN_CENTER_VERTICAL, 4);
+  top->Add(fuzzy, 0, wxALL | wxALIGN_CENTER_VERTICAL, 4);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(top, 0, wxEXPAND);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(SearchPanel, wxFrame)
+  EVT_CLOSE(SearchPanel::OnClose)
+  EVT_TEXT(PANEL_QUERY, SearchPanel::OnText)
+  EVT_TEXT_ENTER(PANEL_QUERY, SearchPanel::OnEnter)
+  EVT_CHECKBOX(PANEL_FUZZY, SearchPanel::OnText)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, SearchPanel::OnActivate)
+END_EVENT_TABLE()
+
+void SearchPanel::Focus()
+{
+  query->SetFocus();
+}
+
+void SearchPanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  search.Cancel();
+  Hide();
+}
+
+void SearchPanel::OnText(wxCommandEvent& WXUNUSED(event) )
+{
+  wxString str = query->GetValue();
+  if (str.IsEmpty()) {
+    search.Cancel();
+    current = 0;
+    ShowResults(0, NameSearch::Results());
+    return;
+  }
+
+  // results come back on the search thread, so hand them over to ours
+  timer.Start();
+  current = search.Start(str, fuzzy->GetValue(), [this](unsigned id, NameSearch::Results results) {
+    CallAfter([this, id, results]() { ShowResults(id, results); });
+  });
+}
+
+void SearchPanel::ShowResults(unsigned id, NameSearch::Results results)
+{
+  // an older search may still have delivered its results
+  if (id != current) return;
+  list->results = results;
+  list->SetItemCount(results ? results->size() : 0);
+  list->Refresh();
+  if (results) {
+    frame->SetStatusText(wxString::Format(wxT("%zu matches (%ld ms)."),
+                                          results->size(), timer.Time()));
+  }
+}
+
+void SearchPanel::Select(long item)
+{
+  const auto& results = list->results;
+  if (!results || item < 0 || (size_t)item >= results->size()) return;
+  const Star *star = (*results)[item].star;
+  if (star->is3d) {
+    frame->canvas->CenterOn(star);
+  } else {
+    frame->SetStatusText(star_label(star) + wxT(" has no known distance."));
+  }
+}
+
+void SearchPanel::OnEnter(wxCommandEvent& WXUNUSED(event) )
+{
+  Select(0);
+}
+
+void SearchPanel::OnActivate(wxListEvent& event)
+{
+  Select(event.GetIndex());
+}
+
+NeighbourPanel::NeighbourPanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Nearest stars", wxDefaultPosition, wxSize(300, 400),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  wxBoxSizer *top = new wxBoxSizer(wxHORIZONTAL);
+  top->Add(new wxStaticText(this, -1, "Show"), 0, wxALL | wxALIGN_CENTER_VERTICAL, 4);
+  count = new wxSpinCtrl(this, PANEL_COUNT, wxT("10"), wxDefaultPosition, wxDefaultSize,
+                         wxSP_ARROW_KEYS, 1, MAX_NEIGHBOURS, 10);
+  top->Add(count, 0, wxALL, 4);
+
+  list = new wxListCtrl(this, PANEL_LIST, wxDefaultPosition, wxDefaultSize,
+                        wxLC_REPORT | wxLC_SINGLE_SEL);
+  list->InsertColumn(0, "Name", wxLIST_FORMAT_LEFT, 170);
+  list->InsertColumn(1, "Distance", wxLIST_FORMAT_RIGHT, 90);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(top, 0, wxEXPAND);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(NeighbourPanel, wxFrame)
+  EVT_CLOSE(NeighbourPanel::OnClose)
+  EVT_SPINCTRL(PANEL_COUNT, NeighbourPanel::OnCount)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, NeighbourPanel::OnActivate)
+END_EVENT_TABLE()
+
+void NeighbourPanel::RefChanged()
+{
+  if (!IsShown()) return;
+
+  list->DeleteAllItems();
+  shown.clear();
+
+  const Star *ref = frame->canvas->GetRefStar();
+  if (!ref) return;
+  SetTitle(wxString::Format(wxT("Nearest to %s"), star_label(ref)));
+
+  // the graph was built along with the star list, for the largest
+  // count we offer
+  std::vector<NeighbourGraph::Neighbour> found;
+  neighbour_graph.Get(ref, count->GetValue(), found);
+
+  for (const auto& it : found) {
+    long item = list->InsertItem(list->GetItemCount(), star_label(it.second));
+    list->SetItem(item, 1, wxString::Format(wxT("%.2f ly"), it.first * LIGHTYEAR_PER_PARSEC));
+    shown.push_back(it.second);
+  }
+}
+
+void NeighbourPanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  // just hide, the main frame keeps us around
+  Hide();
+}
+
+void NeighbourPanel::OnCount(wxSpinEvent& WXUNUSED(event) )
+{
+  RefChanged();
+}
+
+void NeighbourPanel::OnActivate(wxListEvent& event)
+{
+  long item = event.GetIndex();
+  if (item >= 0 && (size_t)item < shown.size()) {
+    frame->canvas->CenterOn(shown[item]);
+  }
+}
+
+DistanceList::DistanceList(wxWindow *parent, int id)
+  : wxListCtrl(parent, id, wxDefaultPosition, wxDefaultSize,
+               wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_VIRTUAL),
+    order((const std::vector<uint32_t> *)NULL)
+{
+  InsertColumn(0, "Name", wxLIST_FORMAT_LEFT, 170);
+  InsertColumn(1, "Distance", wxLIST_FORMAT_RIGHT, 90);
+  InsertColumn(2, "Type", wxLIST_FORMAT_LEFT, 70);
+}
+
+const Star *DistanceList::GetStar(long item) const
+{
+  // the star list may have been reloaded since the last sort
+  if (!order || item < 0 || (size_t)item >= order->size()) return (const Star *)NULL;
+  uint32_t id = (*order)[item];
+  return id < star_table.size() ? star_table[id] : (const Star *)NULL;
+}
+
+wxString DistanceList::OnGetItemText(long item, long column) const
+{
+  const Star *star = GetStar(item);
+  if (!star) return wxEmptyString;
+  switch (column) {
+  case 0:
+    return star_label(star);
+  case 1:
+    return wxString::Format(wxT("%.2f ly"), (star->pos - ref).norm() * LIGHTYEAR_PER_PARSEC);
+  case 2:
+    return star->type;
+  }
+  return wxEmptyString;
+}
+
+DistancePanel::DistancePanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Distances", wxDefaultPosition, wxSize(360, 440),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  list = new DistanceList(this, PANEL_LIST);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(DistancePanel, wxFrame)
+  EVT_CLOSE(DistancePanel::OnClose)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, DistancePanel::OnActivate)
+END_EVENT_TABLE()
+
+void DistancePanel::RefChanged()
+{
+  if (!IsShown()) return;
+
+  const Star *ref = frame->canvas->GetRefStar();
+  SetTitle(wxString::Format(wxT("Distances from %s"),
+                            ref ? star_label(ref) : wxString(wxT("reference"))));
+
+  // the whole star list is in the list, sorted, but only
+  // the rows on screen are ever turned into text
+  wxStopWatch timer;
+  list->ref = frame->canvas->refpos;
+  ref_distances.Update(list->ref);
+  list->order = &ref_distances.GetOrder();
+  list->SetItemCount(list->order->size());
+  list->Refresh();
+  frame->SetStatusText(wxString::Format(wxT("Sorted %zu stars by distance (%ld ms)."),
+                                        list->order->size(), timer.Time()));
+}
+
+void DistancePanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  Hide();
+}
+
+void DistancePanel::OnActivate(wxListEvent& event)
+{
+  const Star *star = list->GetStar(event.GetIndex());
+  if (star) frame->canvas->CenterOn(star);
+}
+
+RoutePanel::RoutePanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Route", wxDefaultPosition, wxSize(360, 420),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  wxFlexGridSizer *fields = new wxFlexGridSizer(2, 4, 4);
+  fields->AddGrowableCol(1);
+  from = new wxTextCtrl(this, -1);
+  to = new wxTextCtrl(this, -1);
+  jump = new wxSpinCtrlDouble(this, -1, wxT("8"), wxDefaultPosition, wxDefaultSize,
+                              wxSP_ARROW_KEYS, 0.1, 1000.0, 8.0, 0.5);
+  fields->Add(new wxStaticText(this, -1, "From"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(from, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, "To"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(to, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, "Max jump (ly)"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(jump, 1, wxEXPAND);
+
+  wxBoxSizer *buttons = new wxBoxSizer(wxHORIZONTAL);
+  buttons->Add(new wxButton(this, PANEL_PLAN, "&Plan"), 0, wxALL, 4);
+  buttons->Add(new wxButton(this, PANEL_CLEAR, "&Clear"), 0, wxALL, 4);
+
+  list = new wxListCtrl(this, PANEL_LIST, wxDefaultPosition, wxDefaultSize,
+                        wxLC_REPORT | wxLC_SINGLE_SEL);
+  list->InsertColumn(0, "Star", wxLIST_FORMAT_LEFT, 170);
+  list->InsertColumn(1, "Jump", wxLIST_FORMAT_RIGHT, 75);
+  list->InsertColumn(2, "Total", wxLIST_FORMAT_RIGHT, 75);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(fields, 0, wxEXPAND | wxALL, 4);
+  sizer->Add(buttons, 0);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(RoutePanel, wxFrame)
+  EVT_CLOSE(RoutePanel::OnClose)
+  EVT_BUTTON(PANEL_PLAN, RoutePanel::OnPlan)
+  EVT_BUTTON(PANEL_CLEAR, RoutePanel::OnClear)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, RoutePanel::OnActivate)
+END_EVENT_TABLE()
+
+void RoutePanel::Prefill()
+{
+  const Star *ref = frame->canvas->GetRefStar();
+  if (ref) from->SetValue(star_label(ref));
+}
+
+void RoutePanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  Hide();
+}
+
+void RoutePanel::OnPlan(wxCommandEvent& WXUNUSED(event) )
+{
+  const Star *start = lookup_star(from->GetValue());
+  const Star *dest = lookup_star(to->GetValue());
+  if (!start || !dest) {
+    wxMessageBox(start ? "Destination not found." : "Starting point not found.",
+                 "Route", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+    return;
+  }
+
+  std::vector<const Star*> route;
+  wxStopWatch timer;
+  bool found = plan_route(start, dest, jump->GetValue() / LIGHTYEAR_PER_PARSEC, route);
+  long elapsed = timer.Time();
+
+  list->DeleteAllItems();
+  frame->canvas->route = route;
+  frame->canvas->Redraw(LAYER_LINES);
+  if (!found) {
+    frame->SetStatusText(wxString::Format(wxT("No route found (%ld ms)."), elapsed));
+    return;
+  }
+  frame->SetStatusText(wxString::Format(wxT("Route found, %zu jumps (%ld ms)."),
+                                        route.size() - 1, elapsed));
+
+  double total = 0.0;
+  for (size_t n = 0; n < route.size(); n++) {
+    double hop = n ? (route[n]->pos - route[n-1]->pos).norm() * LIGHTYEAR_PER_PARSEC : 0.0;
+    total += hop;
+    long item = list->InsertItem(n, star_label(route[n]));
+    if (n) {
+      list->SetItem(item, 1, wxString::Format(wxT("%.2f ly"), hop));
+      list->SetItem(item, 2, wxString::Format(wxT("%.2f ly"), total));
+    }
+  }
+}
+
+void RoutePanel::OnClear(wxCommandEvent& WXUNUSED(event) )
+{
+  list->DeleteAllItems();
+  frame->canvas->route.clear();
+  frame->canvas->Redraw(LAYER_LINES);
+}
+
+void RoutePanel::OnActivate(wxListEvent& event)
+{
+  const auto& route = frame->canvas->route;
+  long item = event.GetIndex();
+  if (item >= 0 && (size_t)item < route.size()) {
+    frame->canvas->CenterOn(route[item]);
+  }
+}
+
+ApproachPanel::ApproachPanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Close approaches", wxDefaultPosition, wxSize(380, 420),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  wxFlexGridSizer *fields = new wxFlexGridSizer(2, 4, 4);
+  fields->AddGrowableCol(1);
+  origin = new wxTextCtrl(this, -1);
+  origin->SetHint("Sun");
+  within = new wxSpinCtrlDouble(this, -1, wxT("5"), wxDefaultPosition, wxDefaultSize,
+                                wxSP_ARROW_KEYS, 0.1, 100.0, 5.0, 0.5);
+  years = new wxSpinCtrl(this, -1, wxT("100000"), wxDefaultPosition, wxDefaultSize,
+                         wxSP_ARROW_KEYS, 100, 10000000, 100000);
+  fields->Add(new wxStaticText(this, -1, "Near"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(origin, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, "Within (ly)"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(within, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, wxT("Years (\u00b1)")), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(years, 1, wxEXPAND);
+
+  list = new wxListCtrl(this, PANEL_LIST, wxDefaultPosition, wxDefaultSize,
+                        wxLC_REPORT | wxLC_SINGLE_SEL);
+  list->InsertColumn(0, "Star", wxLIST_FORMAT_LEFT, 170);
+  list->InsertColumn(1, "Year", wxLIST_FORMAT_RIGHT, 90);
+  list->InsertColumn(2, "Distance", wxLIST_FORMAT_RIGHT, 80);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(fields, 0, wxEXPAND | wxALL, 4);
+  sizer->Add(new wxButton(this, PANEL_FIND, "&Find"), 0, wxALL, 4);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(ApproachPanel, wxFrame)
+  EVT_CLOSE(ApproachPanel::OnClose)
+  EVT_BUTTON(PANEL_FIND, ApproachPanel::OnFind)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, ApproachPanel::OnActivate)
+END_EVENT_TABLE()
+
+void ApproachPanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  Hide();
+}
+
+void ApproachPanel::OnFind(wxCommandEvent& WXUNUSED(event) )
+{
+  // an empty field means the Sun
+  const Star *ref = (const Star *)NULL;
+  if (!origin->GetValue().IsEmpty()) {
+    ref = lookup_star(origin->GetValue());
+    if (!ref) {
+      wxMessageBox("Star not found.", "Close approaches", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+      return;
+    }
+  }
+
+  std::vector<Approach> found;
+  wxStopWatch timer;
+  bool ok = find_approaches(ref, within->GetValue() / LIGHTYEAR_PER_PARSEC, years->GetValue(), found);
+  long elapsed = timer.Time();
+
+  list->DeleteAllItems();
+  shown.clear();
+  if (!ok) {
+    wxMessageBox("The motion of " + star_label(ref) + " is not known.", "Close approaches",
+                 wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+    return;
+  }
+  frame->SetStatusText(wxString::Format(wxT("%zu close approaches found (%ld ms)."),
+                                        found.size(), elapsed));
+
+  for (const auto& it : found) {
+    long item = list->InsertItem(shown.size(), star_label(it.star));
+    list->SetItem(item, 1, wxString::Format(wxT("%.0f"), it.time));
+    list->SetItem(item, 2, wxString::Format(wxT("%.2f ly"), it.distance * LIGHTYEAR_PER_PARSEC));
+    shown.push_back(it.star);
+  }
+}
+
+void ApproachPanel::OnActivate(wxListEvent& event)
+{
+  long item = event.GetIndex();
+  if (item >= 0 && (size_t)item < shown.size()) {
+    frame->canvas->CenterOn(shown[item]);
+  }
+}
+
+GroupPanel::GroupPanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Moving groups", wxDefaultPosition, wxSize(380, 420),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  wxFlexGridSizer *fields = new wxFlexGridSizer(2, 4, 4);
+  fields->AddGrowableCol(1);
+  radius = new wxSpinCtrlDouble(this, -1, wxT("15"), wxDefaultPosition, wxDefaultSize,
+                                wxSP_ARROW_KEYS, 1.0, 200.0, 15.0, 1.0);
+  speed = new wxSpinCtrlDouble(this, -1, wxT("3"), wxDefaultPosition, wxDefaultSize,
+                               wxSP_ARROW_KEYS, 0.1, 100.0, 3.0, 0.5);
+  min_stars = new wxSpinCtrl(this, -1, wxT("5"), wxDefaultPosition, wxDefaultSize,
+                             wxSP_ARROW_KEYS, 2, 100, 5);
+  fields->Add(new wxStaticText(this, -1, "Distance (ly)"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(radius, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, "Velocity (km/s)"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(speed, 1, wxEXPAND);
+  fields->Add(new wxStaticText(this, -1, "Min. stars"), 0, wxALIGN_CENTER_VERTICAL);
+  fields->Add(min_stars, 1, wxEXPAND);
+
+  list = new wxListCtrl(this, PANEL_LIST, wxDefaultPosition, wxDefaultSize,
+                        wxLC_REPORT | wxLC_SINGLE_SEL);
+  list->InsertColumn(0, "Brightest star", wxLIST_FORMAT_LEFT, 170);
+  list->InsertColumn(1, "Stars", wxLIST_FORMAT_RIGHT, 60);
+  list->InsertColumn(2, "Distance", wxLIST_FORMAT_RIGHT, 80);
+
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  sizer->Add(fields, 0, wxEXPAND | wxALL, 4);
+  sizer->Add(new wxButton(this, PANEL_FIND, "&Find"), 0, wxALL, 4);
+  sizer->Add(list, 1, wxEXPAND);
+  SetSizer(sizer);
+}
+
+BEGIN_EVENT_TABLE(GroupPanel, wxFrame)
+  EVT_CLOSE(GroupPanel::OnClose)
+  EVT_BUTTON(PANEL_FIND, GroupPanel::OnFind)
+  EVT_LIST_ITEM_ACTIVATED(PANEL_LIST, GroupPanel::OnActivate)
+END_EVENT_TABLE()
+
+void GroupPanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  Hide();
+}
+
+void GroupPanel::OnFind(wxCommandEvent& WXUNUSED(event) )
+{
+  GroupOptions options;
+  options.radius = radius->GetValue() / LIGHTYEAR_PER_PARSEC;
+  options.speed = speed->GetValue();
+  options.min_stars = min_stars->GetValue();
+
+  wxStopWatch timer;
+  moving_groups.Find(options);
+  long elapsed = timer.Time();
+
+  const auto& found = moving_groups.GetGroups();
+  frame->SetStatusText(wxString::Format(wxT("%zu moving groups found (%ld ms)."),
+                                        found.size(), elapsed));
+  list->DeleteAllItems();
+  for (size_t n = 0; n < found.size(); n++) {
+    long item = list->InsertItem(n, star_label(found[n].members.front()));
+    list->SetItem(item, 1, wxString::Format(wxT("%zu"), found[n].members.size()));
+    list->SetItem(item, 2, wxString::Format(wxT("%.1f ly"),
+                                            found[n].center.norm() * LIGHTYEAR_PER_PARSEC));
+  }
+  frame->SetColorMode(COLOR_GROUP);
+}
+
+void GroupPanel::OnActivate(wxListEvent& event)
+{
+  const auto& found = moving_groups.GetGroups();
+  long item = event.GetIndex();
+  if (item >= 0 && (size_t)item < found.size()) {
+    frame->canvas->CenterOn(found[item].members.front());
+  }
+}
+
+FilterPanel::FilterPanel(StarFrame *parent)
+  : wxFrame(parent, -1, "Filter", wxDefaultPosition, wxSize(360, 440),
+            wxDEFAULT_FRAME_STYLE | wxFRAME_TOOL_WINDOW | wxFRAME_FLOAT_ON_PARENT),
+    frame(parent)
+{
+  wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+  enable = new wxCheckBox(this, -1, "&Enable filter");
+  sizer->Add(enable, 0, wxALL, 4);
+
+  sizer->Add(new wxStaticText(this, -1, "Spectral class"), 0, wxLEFT | wxTOP, 4);
+  wxBoxSizer *row = new wxBoxSizer(wxHORIZONTAL);
+  for (unsigned cls = 0; cls < SPECTRAL_CLASSES; cls++) {
+    wxCheckBox *box = new wxCheckBox(this, -1, spectral_class_name((SpectralClass)cls));
+    box->SetValue(TRUE);
+    row->Add(box, 0, wxALL, 2);
+    classes.push_back(box);
+  }
+  sizer->Add(row, 0, wxALL, 2);
+
+  mag_label = new wxStaticText(this, -1, wxEmptyString);
+  min_mag = new wxSlider(this, -1, FILTER_MAG_MIN, FILTER_MAG_MIN, FILTER_MAG_MAX);
+  max_mag = new wxSlider(this, -1, FILTER_MAG_MAX, FILTER_MAG_MIN, FILTER_MAG_MAX);
+  sizer->Add(mag_label, 0, wxLEFT | wxTOP, 4);
+  sizer->Add(min_mag, 0, wxEXPAND);
+  sizer->Add(max_mag, 0, wxEXPAND);
+
+  temp_label = new wxStaticText(this, -1, wxEmptyString);
+  min_temp = new wxSlider(this, -1, 0, 0, FILTER_TEMP_MAX);
+  max_temp = new wxSlider(this, -1, FILTER_TEMP_MAX, 0, FILTER_TEMP_MAX);
+  sizer->Add(temp_label, 0, wxLEFT | wxTOP, 4);
+  sizer->Add(min_temp, 0, wxEXPAND);
+  sizer->Add(max_temp, 0, wxEXPAND);
+
+  dist_label = new wxStaticText(this, -1, wxEmptyString);
+  max_dist = new wxSlider(this, -1, FILTER_DIST_MAX, 1, FILTER_DIST_MAX);
+  sizer->Add(dist_label, 0, wxLEFT | wxTOP, 4);
+  sizer->Add(max_dist, 0, wxEXPAND);
+
+  sizer->Add(new wxStaticText(this, -1, "Catalogs"), 0, wxLEFT | wxTOP, 4);
+  for (const auto& name : get_catalog_names()) {
+    wxCheckBox *box = new wxCheckBox(this, -1, name);
+    box->SetValue(TRUE);
+    sizer->Add(box, 0, wxALL, 2);
+    catalogs.push_back(box);
+  }
+  SetSizer(sizer);
+
+  wxCommandEvent event;
+  OnChange(event);
+}
+
+BEGIN_EVENT_TABLE(FilterPanel, wxFrame)
+  EVT_CLOSE(FilterPanel::OnClose)
+  EVT_CHECKBOX(wxID_ANY, FilterPanel::OnChange)
+  EVT_SLIDER(wxID_ANY, FilterPanel::OnChange)
+END_EVENT_TABLE()
+
+void FilterPanel::OnClose(wxCloseEvent& WXUNUSED(event) )
+{
+  Hide();
+}
+
+void FilterPanel::OnChange(wxCommandEvent& WXUNUSED(event) )
+{
+  StarFilter& filter = frame->canvas->filter;
+  filter = StarFilter();
+
+  filter.classes = 0;
+  for (size_t n = 0; n < classes.size(); n++) {
+    if (classes[n]->GetValue()) filter.classes |= 1u << n;
+  }
+  filter.catalogs = 0;
+  for (size_t n = 0; n < catalogs.size(); n++) {
+    if (catalogs[n]->GetValue()) filter.catalogs |= 1u << n;
+  }
+
+  wxString lo = wxT("any"), hi = wxT("any");
+  if (min_mag->GetValue() > FILTER_MAG_MIN) {
+    filter.min_mag = min_mag->GetValue() / 10.0;
+    lo = wxString::Format(wxT("%.1f"), filter.min_mag);
+  }
+  if (max_mag->GetValue() < FILTER_MAG_MAX) {
+    filter.max_mag = max_mag->GetValue() / 10.0;
+    hi = wxString::Format(wxT("%.1f"), filter.max_mag);
+  }
+  mag_label->SetLabel(wxT("Absolute magnitude: ") + lo + wxT(" to ") + hi);
+
+  lo = hi = wxT("any");
+  if (min_temp->GetValue() > 0) {
+    filter.min_temp = min_temp->GetValue() * 100.0;
+    lo = wxString::Format(wxT("%.0f K"), filter.min_temp);
+  }
+  if (max_temp->GetValue() < FILTER_TEMP_MAX) {
+    filter.max_temp = max_temp->GetValue() * 100.0;
+    hi = wxString::Format(wxT("%.0f K"), filter.max_temp);
+  }
+  temp_label->SetLabel(wxT("Temperature: ") + lo + wxT(" to ") + hi);
+
+  hi = wxT("any");
+  if (max_dist->GetValue() < FILTER_DIST_MAX) {
+    filter.max_dist = max_dist->GetValue() / LIGHTYEAR_PER_PARSEC;
+    hi = wxString::Format(wxT("%d ly"), max_dist->GetValue());
+  }
+  dist_label->SetLabel(wxT("Distance from reference: up to ") + hi);
+
+  frame->canvas->filtering = enable->GetValue();
+  wxStopWatch timer;
+  frame->canvas->UpdateFilter();
+  if (frame->canvas->filtering) {
+    frame->SetStatusText(wxString::Format(wxT("%zu of %zu stars pass the filter (%ld ms)."),
+                                          frame->canvas->selection.Count(),
+                                          frame->canvas->selection.Size(), timer.Time()));
+  }
+}
@@ -0,0 +1,187 @@
+#ifndef STARMAP_PANELS_H
+#define STARMAP_PANELS_H
+
+#include "maths.h"
+#include "search.h"
+#include <vector>
+#include <wx/button.h>
+#include <wx/checkbox.h>
+#include <wx/frame.h>
+#include <wx/listctrl.h>
+#include <wx/slider.h>
+#include <wx/spinctrl.h>
+#include <wx/stopwatch.h>
+#include <wx/stattext.h>
+#include <wx/textctrl.h>
+
+class Star;
+class StarFrame;
+
+// tool windows that accompany the map
+
+class SearchList : public wxListCtrl
+{
+ public:
+  NameSearch::Results results;
+
+  SearchList(wxWindow *parent, int id);
+  wxString OnGetItemText(long item, long column) const;
+};
+
+class SearchPanel : public wxFrame
+{
+ public:
+  SearchPanel(StarFrame *parent);
+
+  // put the cursor in the search box
+  void Focus();
+
+  void OnClose(wxCloseEvent& event);
+  void OnText(wxCommandEvent& event);
+  void OnEnter(wxCommandEvent& event);
+  void OnActivate(wxListEvent& event);
+  void ShowResults(unsigned id, NameSearch::Results results);
+
+ protected:
+  StarFrame *frame;
+  wxTextCtrl *query;
+  wxCheckBox *fuzzy;
+  SearchList *list;
+  NameSearch search;
+  unsigned current; // id of the search whose results we want
+  wxStopWatch timer;
+
+  void Select(long item);
+
+  DECLARE_EVENT_TABLE()
+};
+
+class NeighbourPanel : public wxFrame
+{
+ public:
+  NeighbourPanel(StarFrame *parent);
+
+  // refill the list for the current reference star
+  void RefChanged();
+
+  void OnClose(wxCloseEvent& event);
+  void OnCount(wxSpinEvent& event);
+  void OnActivate(wxListEvent& event);
+
+ protected:
+  StarFrame *frame;
+  wxSpinCtrl *count;
+  wxListCtrl *list;
+  std::vector<const Star*> shown;
+
+  DECLARE_EVENT_TABLE()
+};
+
+class DistanceList : public wxListCtrl
+{
+ public:
+  Vector ref;
+  const std::vector<uint32_t> *order; // star ids, nearest first
+
+  DistanceList(wxWindow *parent, int id);
+  wxString OnGetItemText(long item, long column) const;
+  const Star *GetStar(long item) const;
+};
+
+class DistancePanel : public wxFrame
+{
+ public:
+  DistancePanel(StarFrame *parent);
+
+  // re-sort the list for the current reference point
+  void RefChanged();
+
+  void OnClose(wxCloseEvent& event);
+  void OnActivate(wxListEvent& event);
+
+ protected:
+  StarFrame *frame;
+  DistanceList *list;
+
+  DECLARE_EVENT_TABLE()
+};
+
+class RoutePanel : public wxFrame
+{
+ public:
+  RoutePanel(StarFrame *parent);
+
+  // start from the reference star
+  void Prefill();
+
+  void OnClose(wxCloseEvent& event);
+  void OnPlan(wxCommandEvent& event);
+  void OnClear(wxCommandEvent& event);
+  void OnActivate(wxListEvent& event);
+
+ protected:
+  StarFrame *frame;
+  wxTextCtrl *from, *to;
+  wxSpinCtrlDouble *jump;
+  wxListCtrl *list;
+
+  DECLARE_EVENT_TABLE()
+};
+
+class ApproachPanel : public wxFrame
+{
+ public:
+  ApproachPanel(StarFrame *parent);
+
+  void OnClose(wxCloseEvent& event);
+  void OnFind(wxCommandEvent& event);
+  void OnActivate(wxListEvent& event);
+
+ protected:
+  StarFrame *frame;
+  wxTextCtrl *origin;
+  wxSpinCtrlDouble *within;
+  wxSpinCtrl *years;
+  wxListCtrl *list;
+  std::vector<const Star*> shown;
+
+  DECLARE_EVENT_TABLE()
+};
+
+class GroupPanel : public wxFrame
+{
+ public:
+  GroupPanel(StarFrame *parent);
+
+  void OnClose(wxCloseEvent& event);
+  void OnFind(wxCommandEvent& event);
+  void OnActivate(wxListEvent& event);
+
+ protected:
+  StarFrame *frame;
+  wxSpinCtrlDouble *radius, *speed;
+  wxSpinCtrl *min_stars;
+  wxListCtrl *list;
+
+  DECLARE_EVENT_TABLE()
+};
+
+class FilterPanel : public wxFrame
+{
+ public:
+  FilterPanel(StarFrame *parent);
+
+  void OnClose(wxCloseEvent& event);
+  void OnChange(wxCommandEvent& event);
+
+ protected:
+  StarFrame *frame;
+  wxCheckBox *enable;
+  std::vector<wxCheckBox*> classes, catalogs;
+  wxSlider *min_mag, *max_mag, *min_temp, *max_temp, *max_dist;
+  wxStaticText *mag_label, *temp_label, *dist_label;
+
+  DECLARE_EVENT_TABLE()
+};
+
+#endif //STARMAP_PANELS_H
@@ -0,0 +1,131 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+thread_local bool in_worker = false;
+
+class WorkerPool {
+public:
+  WorkerPool();
+  ~WorkerPool();
+
+  unsigned Count() const { return (unsigned)_workers.size() + 1; }
+  void Run(size_t chunks, const std::function<void(size_t)>& task);
+
+protected:
+  std::vector<std::thread> _workers;
+  std::mutex _runner; // held by whoever currently owns the pool
+  std::mutex _mutex;  // protects the job description below
+  std::condition_variable _wake, _done;
+
+  const std::function<void(size_t)>* _task = nullptr;
+  size_t _chunks = 0;
+  std::atomic<size_t> _next;
+  unsigned _busy = 0;
+  unsigned _generation = 0;
+  bool _quit = false;
+
+  void Work();
+  void Drain(const std::function<void(size_t)>& task, size_t chunks);
+};
+
+WorkerPool::WorkerPool(): _next(0) {
+  unsigned threads = std::thread::hardware_concurrency();
+  for (unsigned n = 1; n < threads; n++) {
+    _workers.emplace_back(&WorkerPool::Work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _quit = true;
+  }
+  _wake.notify_all();
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+void WorkerPool::Drain(const std::function<void(size_t)>& task, size_t chunks) {
+  size_t n;
+  while ((n = _next++) < chunks) {
+    task(n);
+  }
+}
+
+void WorkerPool::Work() {
+  in_worker = true;
+  unsigned seen = 0;
+  std::unique_lock<std::mutex> guard(_mutex);
+  while (true) {
+    _wake.wait(guard, [&] { return _quit || _generation != seen; });
+    if (_quit) return;
+    seen = _generation;
+    if (!_task) continue;
+    const std::function<void(size_t)>& task = *_task;
+    size_t chunks = _chunks;
+    _busy++;
+    guard.unlock();
+    Drain(task, chunks);
+    guard.lock();
+    if (--_busy == 0) _done.notify_all();
+  }
+}
+
+void WorkerPool::Run(size_t chunks, const std::function<void(size_t)>& task) {
+  std::unique_lock<std::mutex> runner(_runner, std::try_to_lock);
+  if (!runner.owns_lock() || in_worker || _workers.empty() || chunks < 2) {
+    for (size_t n = 0; n < chunks; n++) {
+      task(n);
+    }
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> guard(_mutex);
+    // make sure no straggler from the previous job is still looking at it
+    _done.wait(guard, [&] { return _busy == 0; });
+    _task = &task;
+    _chunks = chunks;
+    _next = 0;
+    _generation++;
+  }
+  _wake.notify_all();
+
+  in_worker = true;
+  Drain(task, chunks);
+  in_worker = false;
+
+  std::unique_lock<std::mutex> guard(_mutex);
+  _done.wait(guard, [&] { return _busy == 0; });
+  _task = nullptr;
+}
+
+WorkerPool& pool() {
+  static WorkerPool instance;
+  return instance;
+}
+
+}
+
+unsigned worker_count() {
+  return pool().Count();
+}
+
+void parallel_for(size_t count, const std::function<void(size_t, size_t)>& fn, size_t grain) {
+  if (count == 0) return;
+  if (grain == 0) grain = 1;
+  size_t chunks = (count + grain - 1) / grain;
+  pool().Run(chunks, [&](size_t n) {
+    size_t begin = n * grain;
+    fn(begin, std::min(begin + grain, count));
+  });
+}
@@ -0,0 +1,57 @@
+#ifndef STARMAP_PARALLEL_H
+#define STARMAP_PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// A small pool of worker threads for data-parallel loops over the catalog.
+// The calling thread takes part in the work. If the pool is already busy
+// (e.g. when called from a background job, or from inside another parallel
+// loop), the loop simply runs serially on the calling thread instead.
+
+// Number of threads (including the caller) that parallel loops may use.
+unsigned worker_count();
+
+// Call fn(begin, end) for consecutive chunks of at most grain items,
+// covering [0, count). Chunks may run in any order and concurrently.
+void parallel_for(size_t count, const std::function<void(size_t, size_t)>& fn,
+                  size_t grain = 1024);
+
+// Sort [first, last) with cmp, like std::sort. Large ranges are split
+// into one run per thread, sorted concurrently and then merged.
+template<typename It, typename Cmp>
+void parallel_sort(It first, It last, Cmp cmp)
+{
+  size_t count = last - first;
+  size_t parts = worker_count();
+  if (count < 65536 || parts < 2) {
+    std::sort(first, last, cmp);
+    return;
+  }
+
+  std::vector<size_t> bounds(parts + 1);
+  for (size_t n = 0; n <= parts; n++) {
+    bounds[n] = count * n / parts;
+  }
+  parallel_for(parts, [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      std::sort(first + bounds[n], first + bounds[n + 1], cmp);
+    }
+  }, 1);
+  // merge neighbouring runs pairwise until only one is left
+  for (size_t width = 1; width < parts; width *= 2) {
+    parallel_for((parts + 2 * width - 1) / (2 * width), [&](size_t begin, size_t end) {
+      for (size_t n = begin; n < end; n++) {
+        size_t lo = n * 2 * width;
+        size_t mid = std::min(lo + width, parts), hi = std::min(lo + 2 * width, parts);
+        if (mid < hi) {
+          std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], cmp);
+        }
+      }
+    }, 1);
+  }
+}
+
+#endif //STARMAP_PARALLEL_H
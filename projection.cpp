@@ -0,0 +1,202 @@
+#include "projection.h"
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROJECT_AVX
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#define PROJECT_SSE2
+#include <emmintrin.h>
+#endif
+
+// Stars closer to the camera plane than this count as behind it,
+// as in Vector::behind().
+static const double near_plane = 0.1;
+
+Projector::Projector(const Transform& cam, double scale, int xc, int yc, int width, int height,
+                     bool orthographic):
+  _scale(scale), _xc(xc), _yc(yc), _width(width), _height(height), _ortho(orthographic)
+{
+  for (unsigned i = 0; i < 3; i++) {
+    for (unsigned j = 0; j < 3; j++) {
+      _r[i][j] = cam._r[i][j];
+    }
+    _t[i] = cam._t[i];
+  }
+}
+
+// The vector versions do the same operations in the same order as this
+// (and as Vector's operators), so all of them give identical results.
+// A point is on screen if wxPoint's truncation puts it in [0, width),
+// i.e. if -1 < x < width. (Orthographic positions are already whole.)
+template<bool ortho>
+void Projector::ProjectScalar(const double *x, const double *y, const double *z, size_t count,
+                              int *sx, int *sy, uint8_t *visible) const
+{
+  for (size_t n = 0; n < count; n++) {
+    double cx = x[n] * _r[0][0] + y[n] * _r[0][1] + z[n] * _r[0][2] + _t[0];
+    double cy = x[n] * _r[1][0] + y[n] * _r[1][1] + z[n] * _r[1][2] + _t[1];
+    double cz = x[n] * _r[2][0] + y[n] * _r[2][1] + z[n] * _r[2][2] + _t[2];
+    double fx, fy;
+    bool on;
+    if (ortho) {
+      fx = floor(_scale * cx) + _xc;
+      fy = floor(_scale * cy) + _yc;
+      on = true;
+    } else {
+      fx = _scale * cx / cz + _xc;
+      fy = _scale * cy / cz + _yc;
+      on = !(cz < near_plane);
+    }
+    on = on && fx > -1.0 && fx < _width && fy > -1.0 && fy < _height;
+    if (on) {
+      sx[n] = (int)fx;
+      sy[n] = (int)fy;
+    }
+    visible[n] = on;
+  }
+}
+
+#ifdef PROJECT_SSE2
+// SSE2 has no floor, so truncate and step down where that rounded up.
+// Out of range values come back as INT_MIN, which is off screen anyway.
+static inline __m128d floor_sse2(__m128d v)
+{
+  __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+  return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, v), _mm_set1_pd(1.0)));
+}
+
+template<bool ortho>
+void Projector::ProjectSSE2(const double *x, const double *y, const double *z, size_t count,
+                            int *sx, int *sy, uint8_t *visible) const
+{
+  const __m128d r00 = _mm_set1_pd(_r[0][0]), r01 = _mm_set1_pd(_r[0][1]), r02 = _mm_set1_pd(_r[0][2]);
+  const __m128d r10 = _mm_set1_pd(_r[1][0]), r11 = _mm_set1_pd(_r[1][1]), r12 = _mm_set1_pd(_r[1][2]);
+  const __m128d r20 = _mm_set1_pd(_r[2][0]), r21 = _mm_set1_pd(_r[2][1]), r22 = _mm_set1_pd(_r[2][2]);
+  const __m128d t0 = _mm_set1_pd(_t[0]), t1 = _mm_set1_pd(_t[1]), t2 = _mm_set1_pd(_t[2]);
+  const __m128d scale = _mm_set1_pd(_scale), xc = _mm_set1_pd(_xc), yc = _mm_set1_pd(_yc);
+  const __m128d width = _mm_set1_pd(_width), height = _mm_set1_pd(_height);
+  const __m128d near = _mm_set1_pd(near_plane), left = _mm_set1_pd(-1.0);
+
+  size_t n = 0;
+  for (; n + 2 <= count; n += 2) {
+    __m128d px = _mm_loadu_pd(x + n), py = _mm_loadu_pd(y + n), pz = _mm_loadu_pd(z + n);
+    __m128d cx = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, r00), _mm_mul_pd(py, r01)),
+                                       _mm_mul_pd(pz, r02)), t0);
+    __m128d cy = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, r10), _mm_mul_pd(py, r11)),
+                                       _mm_mul_pd(pz, r12)), t1);
+    __m128d fx, fy, on;
+    if (ortho) {
+      fx = _mm_add_pd(floor_sse2(_mm_mul_pd(scale, cx)), xc);
+      fy = _mm_add_pd(floor_sse2(_mm_mul_pd(scale, cy)), yc);
+      on = _mm_castsi128_pd(_mm_set1_epi32(-1));
+    } else {
+      __m128d cz = _mm_add_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(px, r20), _mm_mul_pd(py, r21)),
+                                         _mm_mul_pd(pz, r22)), t2);
+      fx = _mm_add_pd(_mm_div_pd(_mm_mul_pd(scale, cx), cz), xc);
+      fy = _mm_add_pd(_mm_div_pd(_mm_mul_pd(scale, cy), cz), yc);
+      on = _mm_cmpnlt_pd(cz, near);
+    }
+    on = _mm_and_pd(on,
+         _mm_and_pd(_mm_and_pd(_mm_cmpgt_pd(fx, left), _mm_cmplt_pd(fx, width)),
+                    _mm_and_pd(_mm_cmpgt_pd(fy, left), _mm_cmplt_pd(fy, height))));
+    int mask = _mm_movemask_pd(on);
+    // off-screen lanes get garbage, which the caller ignores
+    _mm_storel_epi64((__m128i *)(sx + n), _mm_cvttpd_epi32(fx));
+    _mm_storel_epi64((__m128i *)(sy + n), _mm_cvttpd_epi32(fy));
+    visible[n] = mask & 1;
+    visible[n + 1] = (mask >> 1) & 1;
+  }
+  ProjectScalar<ortho>(x + n, y + n, z + n, count - n, sx + n, sy + n, visible + n);
+}
+#endif
+
+#ifdef PROJECT_AVX
+template<bool ortho>
+__attribute__((target("avx")))
+void Projector::ProjectAVX(const double *x, const double *y, const double *z, size_t count,
+                           int *sx, int *sy, uint8_t *visible) const
+{
+  const __m256d r00 = _mm256_set1_pd(_r[0][0]), r01 = _mm256_set1_pd(_r[0][1]), r02 = _mm256_set1_pd(_r[0][2]);
+  const __m256d r10 = _mm256_set1_pd(_r[1][0]), r11 = _mm256_set1_pd(_r[1][1]), r12 = _mm256_set1_pd(_r[1][2]);
+  const __m256d r20 = _mm256_set1_pd(_r[2][0]), r21 = _mm256_set1_pd(_r[2][1]), r22 = _mm256_set1_pd(_r[2][2]);
+  const __m256d t0 = _mm256_set1_pd(_t[0]), t1 = _mm256_set1_pd(_t[1]), t2 = _mm256_set1_pd(_t[2]);
+  const __m256d scale = _mm256_set1_pd(_scale), xc = _mm256_set1_pd(_xc), yc = _mm256_set1_pd(_yc);
+  const __m256d width = _mm256_set1_pd(_width), height = _mm256_set1_pd(_height);
+  const __m256d near = _mm256_set1_pd(near_plane), left = _mm256_set1_pd(-1.0);
+
+  size_t n = 0;
+  for (; n + 4 <= count; n += 4) {
+    __m256d px = _mm256_loadu_pd(x + n), py = _mm256_loadu_pd(y + n), pz = _mm256_loadu_pd(z + n);
+    __m256d cx = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, r00), _mm256_mul_pd(py, r01)),
+                                             _mm256_mul_pd(pz, r02)), t0);
+    __m256d cy = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, r10), _mm256_mul_pd(py, r11)),
+                                             _mm256_mul_pd(pz, r12)), t1);
+    __m256d fx, fy, on;
+    if (ortho) {
+      fx = _mm256_add_pd(_mm256_floor_pd(_mm256_mul_pd(scale, cx)), xc);
+      fy = _mm256_add_pd(_mm256_floor_pd(_mm256_mul_pd(scale, cy)), yc);
+      on = _mm256_cmp_pd(fx, fx, _CMP_TRUE_UQ);
+    } else {
+      __m256d cz = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(px, r20), _mm256_mul_pd(py, r21)),
+                                               _mm256_mul_pd(pz, r22)), t2);
+      fx = _mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(scale, cx), cz), xc);
+      fy = _mm256_add_pd(_mm256_div_pd(_mm256_mul_pd(scale, cy), cz), yc);
+      on = _mm256_cmp_pd(cz, near, _CMP_NLT_UQ);
+    }
+    on = _mm256_and_pd(on,
+         _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(fx, left, _CMP_GT_OQ),
+                                     _mm256_cmp_pd(fx, width, _CMP_LT_OQ)),
+                       _mm256_and_pd(_mm256_cmp_pd(fy, left, _CMP_GT_OQ),
+                                     _mm256_cmp_pd(fy, height, _CMP_LT_OQ))));
+    int mask = _mm256_movemask_pd(on);
+    _mm_storeu_si128((__m128i *)(sx + n), _mm256_cvttpd_epi32(fx));
+    _mm_storeu_si128((__m128i *)(sy + n), _mm256_cvttpd_epi32(fy));
+    visible[n] = mask & 1;
+    visible[n + 1] = (mask >> 1) & 1;
+    visible[n + 2] = (mask >> 2) & 1;
+    visible[n + 3] = (mask >> 3) & 1;
+  }
+  ProjectScalar<ortho>(x + n, y + n, z + n, count - n, sx + n, sy + n, visible + n);
+}
+#endif
+
+void Projector::Project(const double *x, const double *y, const double *z, size_t count,
+                        int *sx, int *sy, uint8_t *visible) const
+{
+#ifdef PROJECT_AVX
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  if (has_avx) {
+    if (_ortho) return ProjectAVX<true>(x, y, z, count, sx, sy, visible);
+    return ProjectAVX<false>(x, y, z, count, sx, sy, visible);
+  }
+#endif
+#ifdef PROJECT_SSE2
+  if (_ortho) return ProjectSSE2<true>(x, y, z, count, sx, sy, visible);
+  return ProjectSSE2<false>(x, y, z, count, sx, sy, visible);
+#else
+  if (_ortho) return ProjectScalar<true>(x, y, z, count, sx, sy, visible);
+  return ProjectScalar<false>(x, y, z, count, sx, sy, visible);
+#endif
+}
+
+void ProjectionBatch::Clear()
+{
+  stars.clear();
+  x.clear();
+  y.clear();
+  z.clear();
+}
+
+void ProjectionBatch::Project(const Projector& projector)
+{
+  size_t count = stars.size();
+  sx.resize(count);
+  sy.resize(count);
+  visible.resize(count);
+  parallel_for(count, [&](size_t begin, size_t end) {
+    projector.Project(x.data() + begin, y.data() + begin, z.data() + begin, end - begin,
+                      sx.data() + begin, sy.data() + begin, visible.data() + begin);
+  }, 65536);
+}
@@ -0,0 +1,66 @@
+#ifndef STARMAP_PROJECTION_H
+#define STARMAP_PROJECTION_H
+
+#include "maths.h"
+#include <cstdint>
+#include <vector>
+
+class Star;
+
+// Transforms and projects points in bulk. For each point, this gives the
+// same result as (p * cam).pproject(scale, xc, yc), or oproject for an
+// orthographic projector, and marks it visible if the projected point
+// falls on a width x height screen (and, in perspective, isn't behind the
+// camera). Uses AVX or SSE2 where available.
+
+class Projector {
+public:
+  Projector(const Transform& cam, double scale, int xc, int yc, int width, int height,
+            bool orthographic = false);
+
+  // Project count points given as coordinate arrays. Sets visible[n] to
+  // 1 or 0; the screen position (sx[n], sy[n]) only means anything if it's 1.
+  void Project(const double *x, const double *y, const double *z, size_t count,
+               int *sx, int *sy, uint8_t *visible) const;
+
+protected:
+  double _r[3][3], _t[3];  // as in cam
+  double _scale, _xc, _yc, _width, _height;
+  bool _ortho;
+
+  template<bool ortho>
+  void ProjectScalar(const double *x, const double *y, const double *z, size_t count,
+                     int *sx, int *sy, uint8_t *visible) const;
+  template<bool ortho>
+  void ProjectSSE2(const double *x, const double *y, const double *z, size_t count,
+                   int *sx, int *sy, uint8_t *visible) const;
+  template<bool ortho>
+  void ProjectAVX(const double *x, const double *y, const double *z, size_t count,
+                  int *sx, int *sy, uint8_t *visible) const;
+};
+
+// Points gathered for projection, kept as separate coordinate arrays
+// so that the projection can work through them in blocks.
+class ProjectionBatch {
+public:
+  void Clear();
+  void Add(Star *star, const Vector& p) {
+    double px, py, pz;
+    p.get(px, py, pz);
+    stars.push_back(star);
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+  }
+  size_t Size() const { return stars.size(); }
+
+  // fills sx, sy and visible, using the worker pool for large batches
+  void Project(const Projector& projector);
+
+  std::vector<Star*> stars;
+  std::vector<double> x, y, z;
+  std::vector<int> sx, sy;
+  std::vector<uint8_t> visible;
+};
+
+#endif //STARMAP_PROJECTION_H
@@ -0,0 +1,475 @@
+// starmap-query: answers queries about the merged catalog from the
+// command line, for scripts. Each argument is a query, or if there are
+// none, each line of standard input. Queries:
+//
+//   name TEXT                  stars with a designation containing TEXT
+//   near STAR RADIUS           stars within RADIUS light years of STAR
+//   knn STAR K                 the K stars nearest to STAR
+//   filter KEY=VALUE ...       stars matching all of: class=GKM, mag=LO:HI
+//                              (absolute), temp=LO:HI, dist=LY, from=STAR,
+//                              catalog=gliese,yale
+//   dist STAR STAR ...         distances between each pair of stars
+//
+// STAR is a designation; quote it if it contains spaces ("Alpha Centauri").
+// Results are tab-separated, one row per star, or with --json, one JSON
+// object per query and line.
+
+#include "cache.h"
+#include "filter.h"
+#include "import.h"
+#include "neighbours.h"
+#include "search.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <wx/init.h>
+
+namespace {
+
+bool json = false;
+size_t limit = 100; // rows per query, 0 for no limit
+std::string out;    // flushed when it grows large, and at the end
+
+void flush()
+{
+  fwrite(out.data(), 1, out.size(), stdout);
+  out.clear();
+}
+
+void append(const char *fmt, double value)
+{
+  char buf[64];
+  if (std::isnan(value)) {
+    out += json ? "null" : "";
+    return;
+  }
+  snprintf(buf, sizeof(buf), fmt, value);
+  out += buf;
+}
+
+void append_text(const wxString& text)
+{
+  std::string utf8(text.utf8_str());
+  if (!json) {
+    // tabs and newlines would break the row
+    for (char c : utf8) {
+      out += (c == '\t' || c == '\n' || c == '\r') ? ' ' : c;
+    }
+    return;
+  }
+  out += '"';
+  for (char c : utf8) {
+    switch (c) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\t': out += "\\t"; break;
+    case '\r': out += "\\r"; break;
+    default:
+      if ((unsigned char)c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += c;
+      }
+    }
+  }
+  out += '"';
+}
+
+// The rows of one query. In TSV, each row starts with the number of
+// the query; in JSON, the rows are the elements of "results".
+class QueryOutput {
+public:
+  QueryOutput(size_t number, const std::string& query): _number(number), _rows(0) {
+    if (json) {
+      out += "{\"query\":";
+      append_text(wxString::FromUTF8(query.c_str()));
+      out += ",\"results\":[";
+    } else {
+      out += "# " + std::to_string(number) + " " + query + "\n";
+    }
+  }
+
+  // distance is from the query's reference point, in parsecs
+  void Star(const ::Star *star, double distance) {
+    Begin();
+    double x = star->pos.get_x() * LIGHTYEAR_PER_PARSEC;
+    double y = star->pos.get_y() * LIGHTYEAR_PER_PARSEC;
+    double z = 0.0 - star->pos.get_z() * LIGHTYEAR_PER_PARSEC; // as the map shows it
+    if (!star->is3d) x = y = z = NAN;
+    if (json) {
+      out += "{\"name\":";
+      append_text(star_label(star));
+      out += ",\"distance\":";
+      append("%.3f", distance * LIGHTYEAR_PER_PARSEC);
+      out += ",\"position\":[";
+      append("%.3f", x);
+      out += ",";
+      append("%.3f", y);
+      out += ",";
+      append("%.3f", z);
+      out += "],\"vmag\":";
+      append("%.2f", star->vmag);
+      out += ",\"type\":";
+      append_text(star->type);
+      out += "}";
+    } else {
+      append_text(star_label(star));
+      out += '\t';
+      append("%.3f", distance * LIGHTYEAR_PER_PARSEC);
+      out += '\t';
+      append("%.3f", x);
+      out += '\t';
+      append("%.3f", y);
+      out += '\t';
+      append("%.3f", z);
+      out += '\t';
+      append("%.2f", star->vmag);
+      out += '\t';
+      append_text(star->type);
+      out += '\n';
+    }
+  }
+
+  void Pair(const ::Star *from, const ::Star *to, double distance) {
+    Begin();
+    if (json) {
+      out += "{\"from\":";
+      append_text(star_label(from));
+      out += ",\"to\":";
+      append_text(star_label(to));
+      out += ",\"distance\":";
+      append("%.3f", distance * LIGHTYEAR_PER_PARSEC);
+      out += "}";
+    } else {
+      append_text(star_label(from));
+      out += '\t';
+      append_text(star_label(to));
+      out += '\t';
+      append("%.3f", distance * LIGHTYEAR_PER_PARSEC);
+      out += '\n';
+    }
+  }
+
+  void Error(const std::string& message) {
+    if (json) {
+      out += "],\"error\":";
+      append_text(wxString::FromUTF8(message.c_str()));
+      _error = true;
+    } else {
+      out += std::to_string(_number) + "\terror\t" + message + "\n";
+    }
+  }
+
+  ~QueryOutput() {
+    if (json) out += _error ? "}\n" : "]}\n";
+    if (out.size() > (1 << 16)) flush();
+  }
+
+protected:
+  size_t _number, _rows;
+  bool _error = false;
+
+  void Begin() {
+    if (json) {
+      if (_rows) out += ',';
+    } else {
+      out += std::to_string(_number) + '\t';
+    }
+    _rows++;
+  }
+};
+
+// split a query into words, keeping quoted strings together
+std::vector<std::string> split(const std::string& line)
+{
+  std::vector<std::string> words;
+  std::string word;
+  bool quoted = false, any = false;
+  for (char c : line) {
+    if (c == '"') {
+      quoted = !quoted;
+      any = true;
+    } else if (!quoted && (c == ' ' || c == '\t')) {
+      if (any) words.push_back(word);
+      word.clear();
+      any = false;
+    } else {
+      word += c;
+      any = true;
+    }
+  }
+  if (any) words.push_back(word);
+  return words;
+}
+
+const Star *lookup(const std::string& name, std::string& error)
+{
+  wxString wname = wxString::FromUTF8(name.c_str());
+  const Star *star = find_star(wname);
+  if (!star) {
+    // not an exact designation, take the best match the search gives
+    std::vector<NameMatch> matches;
+    std::atomic<bool> cancel(false);
+    name_index.Search(wname, matches, cancel);
+    if (!matches.empty()) star = matches.front().star;
+  }
+  if (!star) error = "no star called " + name;
+  else if (!star->is3d) error = name + " has no known distance";
+  else return star;
+  return (const Star *)NULL;
+}
+
+bool parse_number(const std::string& str, double& value)
+{
+  char *end;
+  value = strtod(str.c_str(), &end);
+  return !str.empty() && *end == 0;
+}
+
+// a whole number above zero; very large ones come back as SIZE_MAX
+bool parse_count(const std::string& str, size_t& value)
+{
+  if (str.empty() || !isdigit((unsigned char)str[0])) return false;
+  char *end;
+  errno = 0;
+  unsigned long long n = strtoull(str.c_str(), &end, 10);
+  if (*end != 0 || n == 0) return false;
+  value = errno == ERANGE || n > SIZE_MAX ? SIZE_MAX : (size_t)n;
+  return true;
+}
+
+// LO:HI, where either end may be left out
+bool parse_range(const std::string& str, double& lo, double& hi)
+{
+  size_t colon = str.find(':');
+  if (colon == std::string::npos) return false;
+  std::string a = str.substr(0, colon), b = str.substr(colon + 1);
+  if (!a.empty() && !parse_number(a, lo)) return false;
+  if (!b.empty() && !parse_number(b, hi)) return false;
+  return true;
+}
+
+void query_name(QueryOutput& q, const std::vector<std::string>& words)
+{
+  std::string text;
+  for (size_t n = 1; n < words.size(); n++) {
+    if (n > 1) text += ' ';
+    text += words[n];
+  }
+  if (text.empty()) return q.Error("usage: name TEXT");
+  std::vector<NameMatch> matches;
+  std::atomic<bool> cancel(false);
+  name_index.Search(wxString::FromUTF8(text.c_str()), matches, cancel);
+  for (size_t n = 0; n < matches.size() && (!limit || n < limit); n++) {
+    const Star *star = matches[n].star;
+    q.Star(star, star->is3d ? star->pos.norm() : NAN);
+  }
+}
+
+void query_near(QueryOutput& q, const std::vector<std::string>& words)
+{
+  double radius;
+  if (words.size() != 3 || !parse_number(words[2], radius)) return q.Error("usage: near STAR RADIUS");
+  std::string error;
+  const Star *ref = lookup(words[1], error);
+  if (!ref) return q.Error(error);
+  std::vector<StarIndex::Neighbour> found;
+  star_index.ForEachInRadius(ref->pos, radius / LIGHTYEAR_PER_PARSEC,
+                             [&](const StarIndex::Entry& entry, double d2) {
+    found.emplace_back(d2, entry.star);
+  });
+  std::sort(found.begin(), found.end());
+  for (size_t n = 0; n < found.size() && (!limit || n < limit); n++) {
+    q.Star(found[n].second, sqrt(found[n].first));
+  }
+}
+
+void query_knn(QueryOutput& q, const std::vector<std::string>& words)
+{
+  size_t k;
+  if (words.size() != 3 || !parse_count(words[2], k)) return q.Error("usage: knn STAR K");
+  std::string error;
+  const Star *ref = lookup(words[1], error);
+  if (!ref) return q.Error(error);
+  // no star has more neighbours than that, and lists no longer than the
+  // neighbour graph's (which comes with the cache) are looked up there
+  k = std::min(k, star_table.size());
+  std::vector<StarIndex::Neighbour> found;
+  if (neighbour_graph.IsBuilt() && k <= neighbour_graph.GetK()) neighbour_graph.Get(ref, k, found);
+  else star_index.Nearest(ref->pos, k, found, ref);
+  for (const auto& it : found) {
+    q.Star(it.second, it.first);
+  }
+}
+
+void query_filter(QueryOutput& q, const std::vector<std::string>& words)
+{
+  StarFilter filter;
+  filter.ref = Vector(0, 0, 0);
+  for (size_t n = 1; n < words.size(); n++) {
+    const std::string& word = words[n];
+    size_t eq = word.find('=');
+    std::string key = word.substr(0, eq), value = eq == std::string::npos ? "" : word.substr(eq + 1);
+    bool ok = eq != std::string::npos;
+    if (!ok) {
+    } else if (key == "class") {
+      filter.classes = 0;
+      for (char c : value) {
+        if (c == ',') continue;
+        unsigned cls;
+        for (cls = 0; cls < SPECTRAL_OTHER; cls++) {
+          if (spectral_class_name((SpectralClass)cls) == wxString((wxChar)toupper(c))) break;
+        }
+        if (cls == SPECTRAL_OTHER) ok = false;
+        filter.classes |= 1u << cls;
+      }
+    } else if (key == "mag") {
+      ok = parse_range(value, filter.min_mag, filter.max_mag);
+    } else if (key == "temp") {
+      ok = parse_range(value, filter.min_temp, filter.max_temp);
+    } else if (key == "dist") {
+      ok = parse_number(value, filter.max_dist);
+      filter.max_dist /= LIGHTYEAR_PER_PARSEC;
+    } else if (key == "from") {
+      std::string error;
+      const Star *ref = lookup(value, error);
+      if (!ref) return q.Error(error);
+      filter.ref = ref->pos;
+    } else if (key == "catalog") {
+      filter.catalogs = 0;
+      const auto& names = get_catalog_names();
+      size_t start = 0;
+      while (start <= value.size()) {
+        size_t comma = value.find(',', start);
+        if (comma == std::string::npos) comma = value.size();
+        std::string name = value.substr(start, comma - start);
+        start = comma + 1;
+        // "gliese" is enough for "Gliese star catalog"
+        wxString prefix = wxString::FromUTF8(name.c_str()).Lower();
+        auto it = std::find_if(names.begin(), names.end(), [&](const wxString& catalog) {
+          return !prefix.IsEmpty() && catalog.Lower().StartsWith(prefix);
+        });
+        if (it == names.end()) return q.Error("no catalog called " + name);
+        filter.catalogs |= 1u << (it - names.begin());
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) return q.Error("bad filter term " + word);
+  }
+
+  StarSelection selection;
+  selection.Apply(filter);
+  size_t rows = 0;
+  for (size_t id = 0; id < star_table.size() && (!limit || rows < limit); id++) {
+    if (!selection.IsSelected((unsigned)id)) continue;
+    q.Star(star_table[id], (star_table[id]->pos - filter.ref).norm());
+    rows++;
+  }
+}
+
+void query_dist(QueryOutput& q, const std::vector<std::string>& words)
+{
+  if (words.size() < 3) return q.Error("usage: dist STAR STAR ...");
+  std::vector<const Star*> list;
+  for (size_t n = 1; n < words.size(); n++) {
+    std::string error;
+    const Star *star = lookup(words[n], error);
+    if (!star) return q.Error(error);
+    list.push_back(star);
+  }
+  for (size_t i = 0; i < list.size(); i++) {
+    for (size_t j = i + 1; j < list.size(); j++) {
+      q.Pair(list[i], list[j], (list[i]->pos - list[j]->pos).norm());
+    }
+  }
+}
+
+void run_query(size_t number, const std::string& line)
+{
+  std::vector<std::string> words = split(line);
+  if (words.empty()) return;
+  QueryOutput q(number, line);
+  const std::string& cmd = words[0];
+  if (cmd == "name") query_name(q, words);
+  else if (cmd == "near") query_near(q, words);
+  else if (cmd == "knn") query_knn(q, words);
+  else if (cmd == "filter") query_filter(q, words);
+  else if (cmd == "dist") query_dist(q, words);
+  else q.Error("unknown query " + cmd);
+}
+
+void usage()
+{
+  fprintf(stderr,
+          "usage: starmap-query [--cache FILE] [--rebuild] [--crossmatch] [--json] [--limit N] [QUERY...]\n"
+          "queries:\n"
+          "  name TEXT\n"
+          "  near STAR RADIUS\n"
+          "  knn STAR K\n"
+          "  filter [class=GKM] [mag=LO:HI] [temp=LO:HI] [dist=LY] [from=STAR] [catalog=NAME,...]\n"
+          "  dist STAR STAR ...\n"
+          "Without queries on the command line, reads one per line from standard input.\n");
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  wxInitializer init;
+  if (!init.IsOk()) {
+    fprintf(stderr, "starmap-query: couldn't initialize wxWidgets\n");
+    return 1;
+  }
+
+  wxString cache;
+  bool rebuild = false, crossmatch = false;
+  std::vector<std::string> queries;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--cache" && i + 1 < argc) cache = wxString::FromUTF8(argv[++i]);
+    else if (arg == "--rebuild") rebuild = true;
+    else if (arg == "--crossmatch") crossmatch = true;
+    else if (arg == "--json") json = true;
+    else if (arg == "--limit" && i + 1 < argc) limit = strtoul(argv[++i], NULL, 10);
+    else if (arg == "--help" || arg.compare(0, 2, "--") == 0) {
+      usage();
+      return arg == "--help" ? 0 : 2;
+    }
+    else queries.push_back(arg);
+  }
+
+  // the catalogs are only parsed when there's no usable cache
+  if (cache.IsEmpty() || rebuild || !load_star_cache(cache, crossmatch)) {
+    import_all(crossmatch);
+    if (!cache.IsEmpty() && !save_star_cache(cache, crossmatch)) {
+      fprintf(stderr, "starmap-query: couldn't write %s\n", std::string(cache.utf8_str()).c_str());
+    }
+  }
+
+  size_t number = 0;
+  if (!queries.empty()) {
+    for (const auto& query : queries) {
+      run_query(++number, query);
+    }
+  } else {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      run_query(++number, line);
+    }
+  }
+  flush();
+  return 0;
+}
@@ -0,0 +1,164 @@
+#include "reach.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+
+// bumped by index_stars(), which makes kept lists and searches stale
+static std::atomic<unsigned> star_generation(1);
+static const bool cleared = on_index_stars([]() { star_generation++; });
+
+ReachMap::State::State(size_t count, unsigned from, double max_jump, unsigned generation)
+  : hops(count),
+    cancel(false),
+    done(false),
+    from(from),
+    max_jump(max_jump),
+    generation(generation)
+{
+  for (auto& h : hops) {
+    h.store(-1, std::memory_order_relaxed);
+  }
+}
+
+ReachMap::~ReachMap()
+{
+  Stop();
+}
+
+void ReachMap::Stop()
+{
+  Cancel();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _quit = true;
+  }
+  _wake.notify_one();
+  if (_thread.joinable()) _thread.join();
+  // a later Start() gets a new thread
+  _quit = false;
+}
+
+void ReachMap::Cancel()
+{
+  if (_state) _state->cancel = true;
+  _state.reset();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _pending = false;
+  _job = Job();
+}
+
+void ReachMap::Start(const Star *from, double max_jump, const Callback& progress)
+{
+  Cancel();
+  if (!from || from->id >= star_table.size() || star_table[from->id] != from) return;
+
+  unsigned generation = star_generation;
+  for (auto it = _recent.begin(); it != _recent.end(); ++it) {
+    const State& kept_state = **it;
+    if (kept_state.done && kept_state.generation == generation &&
+        kept_state.from == from->id && kept_state.max_jump == max_jump) {
+      // most recently used last
+      _state = *it;
+      _recent.erase(it);
+      _recent.push_back(_state);
+      progress();
+      return;
+    }
+  }
+
+  _state = std::make_shared<State>(star_table.size(), from->id, max_jump, generation);
+  _recent.erase(std::remove_if(_recent.begin(), _recent.end(),
+                               [&](const std::shared_ptr<State>& state) {
+                                 return !state->done || state->generation != generation;
+                               }), _recent.end());
+  if (_recent.size() >= kept) _recent.erase(_recent.begin());
+  _recent.push_back(_state);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = { _state, from->id, max_jump, progress };
+    _pending = true;
+  }
+  _wake.notify_one();
+  if (!_thread.joinable()) _thread = std::thread(&ReachMap::Run, this);
+}
+
+int ReachMap::GetHops(const Star *star) const
+{
+  if (!_state || star->id >= _state->hops.size()) return -1;
+  return _state->hops[star->id].load(std::memory_order_relaxed);
+}
+
+void ReachMap::Run()
+{
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]() { return _pending || _quit; });
+      if (_quit) return;
+      job = std::move(_job);
+      _pending = false;
+    }
+    Search(job);
+  }
+}
+
+void ReachMap::Search(const Job& job)
+{
+  const size_t grain = 64;
+  State *state = job.state.get();
+  std::vector<unsigned> frontier(1, job.from);
+  state->hops[job.from] = 0;
+
+  // A longer jump than the kept lists cover starts them over, at the
+  // new range; a shorter one reuses them and skips the longer links.
+  // Indexing the stars again also starts them over.
+  size_t count = star_table.size();
+  if (_listed.size() != count || job.max_jump > _links_radius ||
+      _links_generation != state->generation) {
+    _links.assign(count, std::vector<Link>());
+    _listed.assign(count, 0);
+    _links_radius = job.max_jump;
+    _links_generation = state->generation;
+  }
+  double max_dist2 = job.max_jump * job.max_jump;
+
+  // Expand the whole frontier in parallel. Whichever thread first claims
+  // a star records its hop count; since all threads are working on the
+  // same level, the count is the same no matter who wins. Each star is
+  // expanded once, so only one thread fills in its list.
+  for (int level = 1; !frontier.empty() && !state->cancel; level++) {
+    std::vector<std::vector<unsigned>> found((frontier.size() + grain - 1) / grain);
+    parallel_for(frontier.size(), [&](size_t begin, size_t end) {
+      std::vector<unsigned>& out = found[begin / grain];
+      for (size_t n = begin; n < end && !state->cancel; n++) {
+        unsigned id = frontier[n];
+        std::vector<Link>& links = _links[id];
+        if (!_listed[id]) {
+          links.clear();
+          star_index.ForEachInRadius(star_table[id]->get_pos(), _links_radius,
+                                     [&](const StarIndex::Entry& entry, double dist2) {
+            links.push_back({ entry.star->id, dist2 });
+          });
+          _listed[id] = 1;
+        }
+        for (const Link& link : links) {
+          if (link.dist2 > max_dist2) continue;
+          int unseen = -1;
+          if (state->hops[link.id].compare_exchange_strong(unseen, level,
+                                                          std::memory_order_relaxed)) {
+            out.push_back(link.id);
+          }
+        }
+      }
+    }, grain);
+
+    frontier.clear();
+    for (const auto& part : found) {
+      frontier.insert(frontier.end(), part.begin(), part.end());
+    }
+    if (!state->cancel) job.progress();
+  }
+  if (!state->cancel) state->done = true;
+}
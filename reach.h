@@ -0,0 +1,92 @@
+#ifndef STARMAP_REACH_H
+#define STARMAP_REACH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Star;
+
+// Number of jumps of limited length needed to get from a reference star
+// to every other star. Computed by a breadth-first search in a background
+// thread, one level at a time, so the results fill in progressively.
+// The stars within jump range of each visited star are kept, so a search
+// with the same or a shorter jump, from any star, needs no tree lookups
+// for the stars an earlier search already visited. The last few finished
+// searches are kept too, so going back to one of them is immediate. All
+// of it is dropped when the star lists are indexed again.
+
+class ReachMap {
+public:
+  typedef std::function<void()> Callback;
+
+  ReachMap(): _pending(false), _quit(false), _links_radius(0.0), _links_generation(0) {}
+  ~ReachMap();
+
+  // Start over from a new reference star, with jumps of at most
+  // max_jump parsecs. The progress callback is called from the
+  // background thread after each completed level, or right away if a
+  // kept search already has the answer. Neither this nor Cancel() waits
+  // for a running search; it's told to stop, and the thread moves on to
+  // the next one.
+  void Start(const Star *from, double max_jump, const Callback& progress);
+  void Cancel();
+  // Cancels, and waits for the background thread to end, so that no
+  // more callbacks come. Call before whatever they refer to goes away.
+  void Stop();
+
+  bool IsActive() const { return (bool)_state; }
+  // number of jumps to star, or -1 if not reached (yet)
+  int GetHops(const Star *star) const;
+
+protected:
+  struct State {
+    std::vector<std::atomic<int>> hops; // by Star::id
+    std::atomic<bool> cancel;
+    std::atomic<bool> done;
+    unsigned from;
+    double max_jump;
+    unsigned generation; // of the star lists searched
+
+    State(size_t count, unsigned from, double max_jump, unsigned generation);
+  };
+
+  struct Job {
+    std::shared_ptr<State> state;
+    unsigned from;
+    double max_jump;
+    Callback progress;
+  };
+
+  struct Link {
+    unsigned id;
+    double dist2; // squared distance
+  };
+
+  static const size_t kept = 8;
+
+  std::shared_ptr<State> _state; // the search shown
+  std::vector<std::shared_ptr<State>> _recent; // the last kept searches, newest last
+
+  // handed from Start() to the background thread
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  Job _job;
+  bool _pending, _quit;
+  std::thread _thread;
+
+  // only used by the background thread
+  std::vector<std::vector<Link>> _links; // by Star::id, within _links_radius
+  std::vector<char> _listed;             // whether _links holds the star's list
+  double _links_radius;
+  unsigned _links_generation;
+
+  void Run();
+  void Search(const Job& job);
+};
+
+#endif //STARMAP_REACH_H
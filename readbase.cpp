@@ -20,6 +20,10 @@ const Transform ReadBase::J2000(
     Vector::dir(Angle((12*60 + 51.4) * M_PI / (12*60)),
                 Angle(-(27*60 + 7.7) * M_PI / (180*60))));
 
+Vector ReadBase::J2000Direction(double ra, double de) {
+  return Vector::dir(Angle(ra), Angle(de)) * J2000;
+}
+
 bool ReadBase::OpenStream(boost::iostreams::filtering_istream& stream, const wxFileName& name) {
   // Open uncompressed file, if any.
   if (name.FileExists()) {
@@ -270,16 +274,18 @@ void ReadBase::Calculate(WorkData& data, const Transform& frame, double epoch) {
     data.star->vmag = data.vmag;
   }
 
-  // Proper motion calculation
+  // Proper motion calculation (milliarcsec to radians, times distance)
+  const double mas = M_PI / (180.0 * 3600.0 * 1000.0);
   data.star->epoch = epoch;
   data.star->motion = Vector::null;
+  data.star->has_motion = !std::isnan(data.pmra) && !std::isnan(data.pmde);
   if (!std::isnan(data.pmra)) {
     data.star->motion += Vector::d_phi_s(Angle(data.ra)) * frame
-                         * (data.pmra * dist);
+                         * (data.pmra * mas * dist);
   }
   if (!std::isnan(data.pmde)) {
     data.star->motion += Vector::d_theta(Angle(data.ra), Angle(data.de)) * frame
-                         * (data.pmde * dist);
+                         * (data.pmde * mas * dist);
   }
   if (data.star->is3d && !std::isnan(data.rvel)) {
     // rvel is given in km/s. To convert to parsec/year, we have
@@ -63,6 +63,10 @@ public:
     // Rate of change of the position/direction vector, in units per year.
     Vector motion;
 
+    // Whether the proper motion is known (if not, motion only
+    // includes the radial velocity, if any).
+    bool has_motion = false;
+
     // If is3d is true: absolute magnitude.
     // If is3d is false: apparent magnitude.
     double vmag = 0.0;
@@ -110,6 +114,13 @@ public:
   virtual wxString GetCatalogName() = 0;
   virtual bool ReadNext(StarData& data) = 0;
 
+  // Unit vector for J2000 equatorial coordinates (radians),
+  // in the same system as the star positions.
+  static Vector J2000Direction(double ra, double de);
+
+  // Genitive of a three-letter constellation abbreviation ("Cen", "CVn").
+  static bool LookupConstellation(wxString& name, const std::string& tok);
+
 protected:
 
   struct WorkData {
@@ -142,8 +153,6 @@ protected:
   static bool ReadGiclas(StarData& data, const std::string& id);
   static bool ReadOtherName(StarData& data, const wxString& pfx, const std::string& name, int priority);
 
-  static bool LookupConstellation(wxString& name, const std::string& tok);
-
   static wxString MakeSuperscript(const std::string& num);
 
   static const Transform B1950;
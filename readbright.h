@@ -13,6 +13,9 @@ public:
   wxString GetCatalogName() override;
   bool ReadNext(StarData& data) override;
 
+  // Greek letter from the catalog's abbreviation ("Alp")
+  static bool LookupGreek(wxString& name, const std::string& tok);
+
 protected:
   boost::iostreams::filtering_istream _catalog;
   boost::iostreams::filtering_istream _notes;
@@ -21,7 +24,6 @@ protected:
 
   void NextNote();
 
-  static bool LookupGreek(wxString& name, const std::string& tok);
   static bool ReadVarStarName(StarData& data, const std::string& name, bool& has_bayer);
   static bool ReadGeneralName(StarData& data, const std::string& name, bool& has_bayer);
 
@@ -82,7 +82,8 @@ bool ReadGliese::ReadNext(StarData& data) {
       work.de = NAN;
     }
     try {
-      double mu = std::stod(line.substr(30, 6));
+      // total proper motion is given in arcsec/year
+      double mu = std::stod(line.substr(30, 6)) * 1000.0;
       Angle theta = Angle::from_deg(std::stod(line.substr(37, 5)));
       work.pmra = mu * theta.sin();
       work.pmde = mu * theta.cos();
@@ -15,12 +15,14 @@ public:
   wxString GetCatalogName() override;
   bool ReadNext(StarData& data) override;
 
+  // Greek letter from the catalog's abbreviation ("ALF")
+  static bool LookupGreek(wxString& name, const std::string& tok);
+
 protected:
   boost::iostreams::filtering_istream _catalog;
   unsigned nn_count;
 
   static bool ReadExtraName(StarData& data, const std::string& name);
-  static bool LookupGreek(wxString& name, const std::string& tok);
 
 
   class RemarkReader {
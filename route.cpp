@@ -0,0 +1,58 @@
+#include "route.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <queue>
+
+bool plan_route(const Star *from, const Star *to, double max_jump,
+                std::vector<const Star*>& route)
+{
+  route.clear();
+  size_t count = star_table.size();
+  if (from->id >= count || star_table[from->id] != from ||
+      to->id >= count || star_table[to->id] != to) return false;
+
+  // A* search, with the straight-line distance to the destination as
+  // the (admissible) heuristic. Each star's jumps are found on demand
+  // with a radius query, so nothing needs to be precomputed.
+  const unsigned none = (unsigned)-1;
+  std::vector<double> cost(count, INFINITY);
+  std::vector<unsigned> prev(count, none);
+  std::vector<bool> done(count, false);
+
+  typedef std::pair<double, unsigned> open_entry; // (estimate, id)
+  std::priority_queue<open_entry, std::vector<open_entry>, std::greater<open_entry>> open;
+
+  const Vector& goal = to->get_pos();
+  cost[from->id] = 0.0;
+  open.emplace((goal - from->get_pos()).norm(), from->id);
+
+  while (!open.empty()) {
+    unsigned id = open.top().second;
+    open.pop();
+    if (done[id]) continue;
+    done[id] = true;
+    if (id == to->id) break;
+
+    const Star *star = star_table[id];
+    double base = cost[id];
+    star_index.ForEachInRadius(star->get_pos(), max_jump,
+                               [&](const StarIndex::Entry& entry, double d2) {
+      unsigned next = entry.star->id;
+      if (done[next]) return;
+      double c = base + sqrt(d2);
+      if (c < cost[next]) {
+        cost[next] = c;
+        prev[next] = id;
+        open.emplace(c + (goal - entry.pos).norm(), next);
+      }
+    });
+  }
+
+  if (!done[to->id]) return false;
+  for (unsigned id = to->id; id != none; id = prev[id]) {
+    route.push_back(star_table[id]);
+  }
+  std::reverse(route.begin(), route.end());
+  return true;
+}
@@ -0,0 +1,14 @@
+#ifndef STARMAP_ROUTE_H
+#define STARMAP_ROUTE_H
+
+#include <vector>
+
+class Star;
+
+// Find the shortest chain of stars from one star to another, where no
+// single jump is longer than max_jump (parsecs). Returns false if there
+// is no such chain. On success, route holds both endpoints too.
+bool plan_route(const Star *from, const Star *to, double max_jump,
+                std::vector<const Star*>& route);
+
+#endif //STARMAP_ROUTE_H
@@ -0,0 +1,24 @@
+#include "screengrid.h"
+
+const unsigned ScreenGrid::none;
+
+void ScreenGrid::Reset(int width, int height, int cell)
+{
+  _width = width > 0 ? width : 1;
+  _height = height > 0 ? height : 1;
+  _cell = cell > 0 ? cell : 1;
+  _cols = (_width + _cell - 1) / _cell;
+  _rows = (_height + _cell - 1) / _cell;
+  _head.assign(_cols * _rows, none);
+  _next.clear();
+  _items.clear();
+}
+
+void ScreenGrid::Add(const wxPoint& p, unsigned item)
+{
+  if (_head.empty()) return;
+  unsigned& head = _head[CellY(p.y) * _cols + CellX(p.x)];
+  _next.push_back(head);
+  _items.push_back(item);
+  head = (unsigned)_items.size() - 1;
+}
@@ -0,0 +1,61 @@
+#ifndef STARMAP_SCREENGRID_H
+#define STARMAP_SCREENGRID_H
+
+#include <vector>
+#include <wx/gdicmn.h>
+
+// Buckets of items at screen positions, so that we can find what's
+// near a given pixel without looking at everything on the screen.
+
+class ScreenGrid {
+public:
+  ScreenGrid(): _width(0), _height(0), _cell(1), _cols(0), _rows(0) {}
+
+  // forget all items and set up for a new screen size
+  void Reset(int width, int height, int cell);
+
+  // add an item (e.g. an index) at the given screen position
+  void Add(const wxPoint& p, unsigned item);
+
+  // call fn(item) for every item in cells within radius pixels of p;
+  // the caller still has to check the exact distance
+  template<typename F> void ForEachNear(const wxPoint& p, int radius, F fn) const;
+
+  // call fn(item) for every item in cells that overlap rect;
+  // again, the caller has to check the exact position
+  template<typename F> void ForEachInRect(const wxRect& rect, F fn) const;
+
+protected:
+  static const unsigned none = (unsigned)-1;
+
+  int _width, _height, _cell, _cols, _rows;
+  std::vector<unsigned> _head;  // first entry of each cell
+  std::vector<unsigned> _next;  // next entry in the same cell
+  std::vector<unsigned> _items; // the item of each entry
+
+  int CellX(int x) const { return x < 0 ? 0 : x >= _width ? _cols - 1 : x / _cell; }
+  int CellY(int y) const { return y < 0 ? 0 : y >= _height ? _rows - 1 : y / _cell; }
+};
+
+template<typename F>
+void ScreenGrid::ForEachNear(const wxPoint& p, int radius, F fn) const
+{
+  ForEachInRect(wxRect(p.x - radius, p.y - radius, 2 * radius + 1, 2 * radius + 1), fn);
+}
+
+template<typename F>
+void ScreenGrid::ForEachInRect(const wxRect& rect, F fn) const
+{
+  if (_head.empty() || rect.IsEmpty()) return;
+  int cx1 = CellX(rect.GetLeft()), cx2 = CellX(rect.GetRight());
+  int cy1 = CellY(rect.GetTop()), cy2 = CellY(rect.GetBottom());
+  for (int cy = cy1; cy <= cy2; cy++) {
+    for (int cx = cx1; cx <= cx2; cx++) {
+      for (unsigned e = _head[cy * _cols + cx]; e != none; e = _next[e]) {
+        fn(_items[e]);
+      }
+    }
+  }
+}
+
+#endif //STARMAP_SCREENGRID_H
@@ -0,0 +1,434 @@
+#include "search.h"
+#include "parallel.h"
+#include "readbright.h"
+#include "readgliese.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cwchar>
+#include <cwctype>
+#include <unordered_map>
+
+NameIndex name_index;
+static const bool cleared = on_index_stars([]() { name_index.Clear(); });
+
+namespace {
+
+// Lowercase, with superscript digits made plain
+// and each run of spaces made a single space.
+std::wstring fold_name(const wxString& name)
+{
+  std::wstring out;
+  bool space = false;
+  for (wxString::const_iterator it = name.begin(); it != name.end(); ++it) {
+    wchar_t c = *it;
+    if (iswspace(c)) {
+      space = !out.empty();
+      continue;
+    }
+    if (c >= 0x2070 && c <= 0x2079) c = '0' + (c - 0x2070);
+    else if (c == 0x00b9) c = '1';
+    else if (c == 0x00b2 || c == 0x00b3) c = '2' + (c - 0x00b2);
+    if (space) out.push_back(' ');
+    space = false;
+    out.push_back(towlower(c));
+  }
+  return out;
+}
+
+// Folds the query, and expands the abbreviations the catalogs use: Greek
+// letters before, and constellations after, another word ("alf cen").
+std::wstring expand_query(const wxString& query)
+{
+  std::wstring folded = fold_name(query);
+  wxString expanded;
+  size_t pos = 0;
+  while (pos < folded.size()) {
+    size_t end = folded.find(' ', pos);
+    if (end == std::wstring::npos) end = folded.size();
+    std::string tok;
+    for (size_t n = pos; n < end && folded[n] >= 'a' && folded[n] <= 'z'; n++) {
+      tok.push_back((char)folded[n]);
+    }
+    wxString word(folded.substr(pos, end - pos));
+    if (tok.size() == end - pos) {
+      std::string upper(tok), capital(tok);
+      std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+      capital[0] = (char)toupper(capital[0]);
+      wxString full;
+      if (end < folded.size() &&
+          (ReadGliese::LookupGreek(full, upper) || ReadBright::LookupGreek(full, capital))) {
+        word = full;
+      } else if (pos > 0 && ReadBase::LookupConstellation(full, capital)) {
+        word = full;
+      }
+    }
+    if (!expanded.IsEmpty()) expanded += wxT(' ');
+    expanded += word;
+    pos = end + 1;
+  }
+  return fold_name(expanded);
+}
+
+// Bits for a character class, for quickly ruling out names without
+// enough of the characters in the query. Rarer characters share bits.
+uint64_t char_bit(wchar_t c)
+{
+  if (c >= 'a' && c <= 'z') return 1ull << (c - 'a');
+  if (c >= '0' && c <= '9') return 1ull << (26 + (c - '0'));
+  return 1ull << (36 + (unsigned)c % 28);
+}
+
+uint64_t char_bits(const wchar_t *str, size_t len)
+{
+  uint64_t bits = 0;
+  for (size_t n = 0; n < len; n++) {
+    bits |= char_bit(str[n]);
+  }
+  return bits;
+}
+
+// How many typos to tolerate in a query of the given length.
+unsigned fuzzy_limit(size_t len)
+{
+  return len <= 2 ? 0 : len <= 5 ? 1 : len <= 10 ? 2 : 3;
+}
+
+// Myers' bit-parallel edit distance, for patterns of up to 64 characters.
+// Distance() gives the fewest edits that turn the pattern into some part
+// of the text, with one pass over the text and a few operations per character.
+class FuzzyPattern {
+public:
+  explicit FuzzyPattern(const std::wstring& pattern);
+
+  size_t Length() const { return _length; }
+  unsigned Distance(const wchar_t *text, size_t len) const;
+
+protected:
+  size_t _length;
+  uint64_t _ascii[128]; // for each character, where it occurs in the pattern
+  std::vector<std::pair<wchar_t, uint64_t>> _other;
+
+  uint64_t Occurrences(wchar_t c) const {
+    if ((unsigned)c < 128) return _ascii[c];
+    for (const auto& other : _other) {
+      if (other.first == c) return other.second;
+    }
+    return 0;
+  }
+};
+
+FuzzyPattern::FuzzyPattern(const std::wstring& pattern)
+  : _length(std::min<size_t>(pattern.size(), 64))
+{
+  std::fill(_ascii, _ascii + 128, 0);
+  for (size_t n = 0; n < _length; n++) {
+    wchar_t c = pattern[n];
+    uint64_t bit = 1ull << n;
+    if ((unsigned)c < 128) {
+      _ascii[c] |= bit;
+      continue;
+    }
+    auto it = std::find_if(_other.begin(), _other.end(), [c](const std::pair<wchar_t, uint64_t>& other) {
+      return other.first == c;
+    });
+    if (it != _other.end()) it->second |= bit;
+    else _other.push_back(std::make_pair(c, bit));
+  }
+}
+
+unsigned FuzzyPattern::Distance(const wchar_t *text, size_t len) const
+{
+  // Column by column, pv/mv mark where the distance goes up/down by one
+  // along the pattern. Matches may start anywhere in the text, so the
+  // top row stays at zero.
+  const uint64_t last = 1ull << (_length - 1);
+  uint64_t pv = ~0ull, mv = 0;
+  unsigned score = (unsigned)_length, best = score;
+  for (size_t n = 0; n < len && best; n++) {
+    uint64_t eq = Occurrences(text[n]);
+    uint64_t xv = eq | mv;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+    if (ph & last) score++;
+    else if (mh & last) score--;
+    ph <<= 1;
+    mh <<= 1;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    best = std::min(best, score);
+  }
+  return best;
+}
+
+}
+
+bool NameMatch::operator<(const NameMatch& other) const
+{
+  if (distance != other.distance) return distance < other.distance;
+  if (kind != other.kind) return kind < other.kind;
+  if (priority != other.priority) return priority < other.priority;
+  if (name->length() != other.name->length()) return name->length() < other.name->length();
+  int c = name->Cmp(*other.name);
+  if (c) return c < 0;
+  return star->names.front().name < other.star->names.front().name;
+}
+
+void NameIndex::Clear()
+{
+  std::lock_guard<std::shared_timed_mutex> guard(_mutex);
+  _built = false;
+  _names.clear();
+  _text.clear();
+  _suffix.clear();
+  _folded.clear();
+}
+
+void NameIndex::Prepare()
+{
+  std::lock_guard<std::shared_timed_mutex> guard(_mutex);
+  if (!_built) Build();
+}
+
+std::shared_lock<std::shared_timed_mutex> NameIndex::Read()
+{
+  // a Clear() can come between building and locking, if rarely
+  for (;;) {
+    std::shared_lock<std::shared_timed_mutex> guard(_mutex);
+    if (_built) return guard;
+    guard.unlock();
+    Prepare();
+  }
+}
+
+void NameIndex::Build()
+{
+  _stars = 0;
+  for (const auto list : { &stars, &dir_stars }) {
+    for (Star *star : *list) {
+      uint32_t owner = _stars++;
+      for (const auto& nit : star->names) {
+        std::wstring folded = fold_name(nit.name);
+        _names.push_back({ star, owner, (uint32_t)_text.size(), (uint32_t)_folded.size(),
+                           (uint32_t)folded.size(), char_bits(folded.data(), folded.size()),
+                           nit.priority, nit.name });
+        wxString lower = nit.name.Lower();
+        const wchar_t *chars = lower.wc_str();
+        _text.insert(_text.end(), chars, chars + wcslen(chars));
+        _text.push_back(0);
+        _folded.insert(_folded.end(), folded.begin(), folded.end());
+        _folded.push_back(0);
+      }
+    }
+  }
+
+  // every position inside a name starts a suffix
+  _suffix.reserve(_text.size() - _names.size());
+  for (uint32_t pos = 0; pos < _text.size(); pos++) {
+    if (_text[pos]) _suffix.push_back(pos);
+  }
+  // Comparisons stop at the end of the name, so equal
+  // suffixes of different names are ordered by position.
+  const wxChar *text = _text.data();
+  parallel_sort(_suffix.begin(), _suffix.end(), [text](uint32_t a, uint32_t b) {
+    int c = wcscmp(text + a, text + b);
+    return c < 0 || (c == 0 && a < b);
+  });
+  _built = true;
+}
+
+size_t NameIndex::NameAt(uint32_t pos) const
+{
+  auto it = std::upper_bound(_names.begin(), _names.end(), pos, [](uint32_t p, const Name& name) {
+    return p < name.start;
+  });
+  return (it - _names.begin()) - 1;
+}
+
+bool NameIndex::Search(const wxString& query, std::vector<NameMatch>& out,
+                       const std::atomic<bool>& cancel)
+{
+  auto guard = Read();
+  out.clear();
+  wxString lower = query.Lower();
+  const wchar_t *q = lower.wc_str();
+  size_t qlen = wcslen(q);
+  if (!qlen) return true;
+
+  // the suffixes that start with the query form one range
+  const wxChar *text = _text.data();
+  auto first = std::lower_bound(_suffix.begin(), _suffix.end(), q, [&](uint32_t pos, const wchar_t *s) {
+    return wcsncmp(text + pos, s, qlen) < 0;
+  });
+  auto last = std::upper_bound(first, _suffix.end(), q, [&](const wchar_t *s, uint32_t pos) {
+    return wcsncmp(s, text + pos, qlen) < 0;
+  });
+
+  // Keep the best match for each star. For big result sets,
+  // a slot per star is cheaper than a hash table.
+  const uint32_t none = UINT32_MAX;
+  std::unordered_map<uint32_t, uint32_t> found;
+  std::vector<uint32_t> slots;
+  if ((size_t)(last - first) > _stars / 64) slots.assign(_stars, none);
+  size_t checked = 0;
+  for (auto it = first; it != last; ++it) {
+    if ((++checked & 1023) == 0 && cancel) return false;
+    uint32_t pos = *it;
+    const Name& name = _names[NameAt(pos)];
+    NameMatch match;
+    match.star = name.star;
+    match.name = &name.name;
+    match.distance = 0;
+    match.priority = name.priority;
+    if (pos == name.start) {
+      match.kind = text[pos + qlen] ? MATCH_PREFIX : MATCH_EXACT;
+    } else {
+      match.kind = iswalnum(text[pos - 1]) ? MATCH_INSIDE : MATCH_WORD;
+    }
+    uint32_t *slot;
+    if (!slots.empty()) {
+      slot = &slots[name.owner];
+    } else {
+      slot = &found.insert(std::make_pair(name.owner, none)).first->second;
+    }
+    if (*slot == none) {
+      *slot = (uint32_t)out.size();
+      out.push_back(match);
+    } else if (match < out[*slot]) {
+      out[*slot] = match;
+    }
+  }
+  if (cancel) return false;
+  std::sort(out.begin(), out.end());
+  return !cancel;
+}
+
+bool NameIndex::Fuzzy(const wxString& query, std::vector<NameMatch>& out,
+                      const std::atomic<bool>& cancel)
+{
+  auto guard = Read();
+  out.clear();
+  std::wstring q = expand_query(query);
+  if (q.empty()) return true;
+  FuzzyPattern pattern(q);
+  size_t qlen = pattern.Length();
+  unsigned limit = fuzzy_limit(qlen);
+  uint64_t qchars = char_bits(q.data(), qlen);
+
+  // every name is checked, in parallel; the matches of each chunk go to its own list
+  const size_t grain = 4096;
+  typedef std::pair<uint32_t, NameMatch> Found; // (owner, match)
+  std::vector<std::vector<Found>> chunks((_names.size() + grain - 1) / grain);
+  parallel_for(_names.size(), [&](size_t begin, size_t end) {
+    std::vector<Found>& found = chunks[begin / grain];
+    for (size_t n = begin; n < end; n++) {
+      if ((n & 1023) == 0 && cancel) return;
+      const Name& name = _names[n];
+      // each query character missing from the name takes an edit
+      if (name.length + limit < qlen) continue;
+      if (std::bitset<64>(qchars & ~name.chars).count() > limit) continue;
+      const wchar_t *folded = &_folded[name.folded];
+      unsigned distance = pattern.Distance(folded, name.length);
+      if (distance > limit) continue;
+      NameMatch match;
+      match.star = name.star;
+      match.name = &name.name;
+      match.distance = distance;
+      match.priority = name.priority;
+      if (distance == 0 && wcsncmp(folded, q.data(), qlen) == 0) {
+        match.kind = name.length == qlen ? MATCH_EXACT : MATCH_PREFIX;
+      } else {
+        match.kind = MATCH_INSIDE;
+      }
+      found.push_back(std::make_pair(name.owner, match));
+    }
+  }, grain);
+  if (cancel) return false;
+
+  // keep the best match for each star
+  const uint32_t none = UINT32_MAX;
+  std::vector<uint32_t> slots(_stars, none);
+  for (const auto& found : chunks) {
+    for (const Found& it : found) {
+      uint32_t& slot = slots[it.first];
+      if (slot == none) {
+        slot = (uint32_t)out.size();
+        out.push_back(it.second);
+      } else if (it.second < out[slot]) {
+        out[slot] = it.second;
+      }
+    }
+  }
+  if (cancel) return false;
+  std::sort(out.begin(), out.end());
+  return !cancel;
+}
+
+NameSearch::NameSearch()
+  : _cancel(false),
+    _fuzzy(false),
+    _pending(0),
+    _last_id(0),
+    _quit(false)
+{
+  _thread = std::thread(&NameSearch::Run, this);
+}
+
+NameSearch::~NameSearch()
+{
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _quit = true;
+    _cancel = true;
+  }
+  _wake.notify_all();
+  _thread.join();
+}
+
+unsigned NameSearch::Start(const wxString& query, bool fuzzy, const Callback& done)
+{
+  unsigned id;
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    id = ++_last_id;
+    _query = query.ToStdWstring();
+    _fuzzy = fuzzy;
+    _done = done;
+    _pending = id;
+    _cancel = true;
+  }
+  _wake.notify_all();
+  return id;
+}
+
+void NameSearch::Cancel()
+{
+  std::lock_guard<std::mutex> guard(_mutex);
+  _pending = 0;
+  _cancel = true;
+}
+
+void NameSearch::Run()
+{
+  std::unique_lock<std::mutex> guard(_mutex);
+  while (true) {
+    _wake.wait(guard, [&] { return _quit || _pending; });
+    if (_quit) return;
+    unsigned id = _pending;
+    wxString query(_query);
+    bool fuzzy = _fuzzy;
+    Callback done = _done;
+    _pending = 0;
+    _cancel = false;
+    guard.unlock();
+
+    Results results = std::make_shared<std::vector<NameMatch>>();
+    bool ok = fuzzy ? name_index.Fuzzy(query, *results, _cancel)
+                    : name_index.Search(query, *results, _cancel);
+    if (ok) done(id, results);
+
+    guard.lock();
+  }
+}
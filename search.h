@@ -0,0 +1,118 @@
+#ifndef STARMAP_SEARCH_H
+#define STARMAP_SEARCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <wx/string.h>
+
+class Star;
+
+// how well a designation matched a query, best first
+enum MatchKind {
+  MATCH_EXACT,
+  MATCH_PREFIX,
+  MATCH_WORD,   // at the start of a later word
+  MATCH_INSIDE
+};
+
+struct NameMatch {
+  Star *star;
+  const wxString *name; // the designation that matched
+  unsigned distance;    // edits needed to match, for fuzzy searches
+  MatchKind kind;
+  int priority;         // of that designation
+
+  bool operator<(const NameMatch& other) const;
+};
+
+// Case-insensitive substring index over the designations of all stars.
+// It's a suffix array over the concatenated (lowercased) names, so every
+// lookup is a binary search, whatever the length of the query. Searches
+// hold a shared lock on it while they run, so Clear() waits for them.
+
+class NameIndex {
+public:
+  void Clear();
+  // build the index unless it's already there; safe to call from any thread
+  void Prepare();
+
+  // All stars with a designation that contains query, best match first,
+  // building the index first if need be. Gives up and returns false as
+  // soon as cancel becomes true.
+  bool Search(const wxString& query, std::vector<NameMatch>& out,
+              const std::atomic<bool>& cancel);
+
+  // Like Search, but tolerates a few typos, and understands the catalogs'
+  // Greek letter and constellation abbreviations ("alf cen", "Sig Dra").
+  // Fewest edits first, then by designation priority.
+  bool Fuzzy(const wxString& query, std::vector<NameMatch>& out,
+             const std::atomic<bool>& cancel);
+
+protected:
+  struct Name {
+    Star *star;
+    uint32_t owner; // numbers the stars, 0 .. _stars - 1
+    uint32_t start; // in _text
+    uint32_t folded; // in _folded
+    uint32_t length; // of the folded name
+    uint64_t chars;  // which characters occur in it, see char_bit()
+    int priority;
+    wxString name;
+  };
+
+  std::shared_timed_mutex _mutex;
+  bool _built = false;
+  std::vector<Name> _names;
+  uint32_t _stars = 0;
+  std::vector<wxChar> _text;     // lowercased names, each followed by a 0
+  std::vector<uint32_t> _suffix; // positions in _text, in suffix order
+  std::vector<wxChar> _folded;   // names as fold_name() gives them, each followed by a 0
+
+  void Build();
+  // a shared lock on the index, built if it wasn't
+  std::shared_lock<std::shared_timed_mutex> Read();
+  size_t NameAt(uint32_t pos) const;
+};
+
+extern NameIndex name_index;
+
+// Runs searches in a background thread, one at a time. Starting a new
+// search cancels the one in progress, without waiting for it.
+
+class NameSearch {
+public:
+  typedef std::shared_ptr<std::vector<NameMatch>> Results;
+  // called from the background thread, unless the search was cancelled
+  typedef std::function<void(unsigned id, Results results)> Callback;
+
+  NameSearch();
+  ~NameSearch();
+
+  // returns an id, which is passed on to done
+  unsigned Start(const wxString& query, bool fuzzy, const Callback& done);
+  void Cancel();
+
+protected:
+  std::thread _thread;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::atomic<bool> _cancel;
+
+  // the next search to run, if _pending is nonzero
+  std::wstring _query;
+  bool _fuzzy;
+  Callback _done;
+  unsigned _pending, _last_id;
+  bool _quit;
+
+  void Run();
+};
+
+#endif //STARMAP_SEARCH_H
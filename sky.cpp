@@ -0,0 +1,95 @@
+#include "sky.h"
+#include "parallel.h"
+#include "readbase.h"
+
+// Aim for about this many entries in each cell.
+static const size_t entries_per_cell = 4;
+
+void SkyIndex::Clear()
+{
+  _rings = 0;
+  _ring_first.clear();
+  _cell_first.clear();
+  _entries.clear();
+}
+
+void SkyIndex::Add(Star *star, const Vector& dir)
+{
+  Vector unit(dir);
+  if (unit.sqr() > 0.0) unit.normalize();
+  _entries.push_back({unit, star});
+}
+
+unsigned SkyIndex::RingOf(double theta) const
+{
+  return std::min(_rings - 1, (unsigned)(theta * _rings / M_PI));
+}
+
+uint32_t SkyIndex::CellOf(const Vector& dir) const
+{
+  double x, y, z;
+  dir.get(x, y, z);
+  unsigned ring = RingOf(acos(std::max(-1.0, std::min(1.0, z))));
+  double phi = atan2(y, x);
+  if (phi < 0.0) phi += 2.0 * M_PI;
+  unsigned cells = CellsIn(ring);
+  return _ring_first[ring] + std::min(cells - 1, (unsigned)(phi * cells / (2.0 * M_PI)));
+}
+
+void SkyIndex::Build()
+{
+  _ring_first.clear();
+  _cell_first.clear();
+  if (_entries.empty()) {
+    _rings = 0;
+    return;
+  }
+
+  // Rings are equally wide in latitude. The area of a ring is
+  // proportional to its height along the polar axis, so give each ring
+  // as many cells as it takes to keep them roughly square.
+  size_t target = std::max(_entries.size() / entries_per_cell, (size_t)12);
+  _rings = std::max(2u, (unsigned)ceil(sqrt(M_PI * target / 4.0)));
+  double side = M_PI / _rings;
+  uint32_t total = 0;
+  for (unsigned ring = 0; ring < _rings; ring++) {
+    double area = 2.0 * M_PI * (cos(ring * side) - cos((ring + 1) * side));
+    _ring_first.push_back(total);
+    total += std::max(1l, lround(area / (side * side)));
+  }
+  _ring_first.push_back(total);
+
+  // sort the entries into their cells (counting sort)
+  std::vector<uint32_t> cell_of(_entries.size());
+  parallel_for(_entries.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      cell_of[n] = CellOf(_entries[n].dir);
+    }
+  });
+  _cell_first.assign(total + 1, 0);
+  for (uint32_t cell : cell_of) {
+    _cell_first[cell + 1]++;
+  }
+  for (uint32_t cell = 0; cell < total; cell++) {
+    _cell_first[cell + 1] += _cell_first[cell];
+  }
+  std::vector<uint32_t> next(_cell_first.begin(), _cell_first.end() - 1);
+  std::vector<Entry> sorted(_entries.size());
+  for (size_t n = 0; n < _entries.size(); n++) {
+    sorted[next[cell_of[n]]++] = _entries[n];
+  }
+  _entries.swap(sorted);
+}
+
+void SkyIndex::Cone(const Vector& dir, double radius, std::vector<Star*>& out) const
+{
+  out.clear();
+  ForEachInCone(dir, radius, [&](const Entry& entry, double) {
+    out.push_back(entry.star);
+  });
+}
+
+Vector radec_direction(double ra, double de)
+{
+  return ReadBase::J2000Direction(Angle::from_deg(ra).rad(), Angle::from_deg(de).rad());
+}
@@ -0,0 +1,99 @@
+#ifndef STARMAP_SKY_H
+#define STARMAP_SKY_H
+
+#include "maths.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class Star;
+
+// Equal-area index over directions on the celestial sphere, for stars
+// that have no known distance. Like HEALPix, the sphere is cut into rings
+// of constant latitude, and each ring into cells of (nearly) the same
+// area, so a cone search only needs to look at the cells it overlaps.
+// Add all directions, call Build() once, then run as many queries as needed.
+
+class SkyIndex {
+public:
+  struct Entry {
+    Vector dir; // unit vector
+    Star *star;
+  };
+
+  void Clear();
+  void Reserve(size_t count) { _entries.reserve(count); }
+  // dir need not be normalized
+  void Add(Star *star, const Vector& dir);
+  void Build();
+
+  size_t Size() const { return _entries.size(); }
+  bool IsEmpty() const { return _entries.empty(); }
+  const std::vector<Entry>& GetEntries() const { return _entries; }
+
+  // call fn(entry, cosine of separation) for each direction
+  // within radius (radians) of dir, which must be a unit vector
+  template<typename F> void ForEachInCone(const Vector& dir, double radius, F fn) const;
+
+  // the stars within radius of dir, in no particular order
+  void Cone(const Vector& dir, double radius, std::vector<Star*>& out) const;
+
+protected:
+  unsigned _rings = 0;
+  std::vector<uint32_t> _ring_first; // first cell of each ring, plus end
+  std::vector<uint32_t> _cell_first; // first entry of each cell, plus end
+  std::vector<Entry> _entries;       // sorted by cell after Build()
+
+  unsigned RingOf(double theta) const;
+  unsigned CellsIn(unsigned ring) const { return _ring_first[ring + 1] - _ring_first[ring]; }
+  uint32_t CellOf(const Vector& dir) const;
+};
+
+// direction of the given J2000 equatorial coordinates (degrees),
+// in the coordinate system used for star positions
+Vector radec_direction(double ra, double de);
+
+template<typename F>
+void SkyIndex::ForEachInCone(const Vector& dir, double radius, F fn) const
+{
+  if (_entries.empty()) return;
+  double x, y, z;
+  dir.get(x, y, z);
+  double theta = acos(std::max(-1.0, std::min(1.0, z)));
+  double phi = atan2(y, x);
+  if (phi < 0.0) phi += 2.0 * M_PI;
+  double cos_r = cos(radius);
+
+  // Longitude half-width of the cone. It's the same for every ring it
+  // touches, unless it covers a pole, in which case whole rings qualify.
+  double dphi = M_PI;
+  if (radius < M_PI / 2 && theta - radius > 0.0 && theta + radius < M_PI) {
+    dphi = asin(std::min(1.0, sin(radius) / sin(theta)));
+  }
+
+  unsigned first = RingOf(std::max(0.0, theta - radius));
+  unsigned last = RingOf(std::min(M_PI, theta + radius));
+  for (unsigned ring = first; ring <= last; ring++) {
+    unsigned cells = CellsIn(ring);
+    double scale = cells / (2.0 * M_PI);
+    long c0 = 0, c1 = (long)cells - 1;
+    if (dphi < M_PI) {
+      c0 = (long)floor((phi - dphi) * scale);
+      c1 = (long)floor((phi + dphi) * scale);
+      if (c1 - c0 + 1 >= (long)cells) {
+        c0 = 0;
+        c1 = (long)cells - 1;
+      }
+    }
+    for (long c = c0; c <= c1; c++) {
+      uint32_t cell = _ring_first[ring] + (uint32_t)((c % (long)cells + cells) % cells);
+      for (uint32_t n = _cell_first[cell]; n < _cell_first[cell + 1]; n++) {
+        const Entry& entry = _entries[n];
+        double cos_sep = entry.dir.get_x() * x + entry.dir.get_y() * y + entry.dir.get_z() * z;
+        if (cos_sep >= cos_r) fn(entry, cos_sep);
+      }
+    }
+  }
+}
+
+#endif //STARMAP_SKY_H
@@ -0,0 +1,187 @@
+#include "spatial.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Subtrees with fewer entries than this are left to a single worker.
+static const uint32_t parallel_threshold = 16384;
+
+void StarIndex::Clear()
+{
+  _entries.clear();
+  _nodes.clear();
+  _tiers.clear();
+}
+
+void StarIndex::SetBounds(Node& node) const
+{
+  for (unsigned a = 0; a < 3; a++) {
+    node.lo[a] = INFINITY;
+    node.hi[a] = -INFINITY;
+  }
+  for (uint32_t n = node.begin; n < node.end; n++) {
+    double c[3];
+    _entries[n].pos.get(c[0], c[1], c[2]);
+    for (unsigned a = 0; a < 3; a++) {
+      if (c[a] < node.lo[a]) node.lo[a] = c[a];
+      if (c[a] > node.hi[a]) node.hi[a] = c[a];
+    }
+  }
+}
+
+uint32_t StarIndex::BuildNode(std::vector<Node>& nodes, uint32_t begin, uint32_t end,
+                              std::vector<uint32_t>* deferred)
+{
+  uint32_t index = (uint32_t)nodes.size();
+  nodes.emplace_back();
+
+  Node node;
+  node.begin = begin;
+  node.end = end;
+  node.left = no_node;
+  node.right = no_node;
+  SetBounds(node);
+
+  if (end - begin > leaf_size) {
+    if (deferred && end - begin <= parallel_threshold) {
+      // leave this subtree for the parallel phase
+      deferred->push_back(index);
+    } else {
+      // split along the longest axis, at the median
+      unsigned axis = 0;
+      for (unsigned a = 1; a < 3; a++) {
+        if (node.hi[a] - node.lo[a] > node.hi[axis] - node.lo[axis]) axis = a;
+      }
+      uint32_t mid = begin + (end - begin) / 2;
+      std::nth_element(_entries.begin() + begin, _entries.begin() + mid, _entries.begin() + end,
+                       [axis](const Entry& a, const Entry& b) {
+                         return Coord(a.pos, axis) < Coord(b.pos, axis);
+                       });
+      node.left = BuildNode(nodes, begin, mid, deferred);
+      node.right = BuildNode(nodes, mid, end, deferred);
+    }
+  }
+
+  nodes[index] = node;
+  return index;
+}
+
+void StarIndex::Build()
+{
+  _nodes.clear();
+  _tiers.clear();
+  if (_entries.empty()) return;
+
+  // Split the top of the tree serially until the pieces are small
+  // enough, then build those subtrees concurrently and splice them in.
+  std::vector<uint32_t> deferred;
+  BuildNode(_nodes, 0, (uint32_t)_entries.size(), &deferred);
+
+  std::vector<std::vector<Node>> subtrees(deferred.size());
+  parallel_for(deferred.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      const Node& root = _nodes[deferred[n]];
+      BuildNode(subtrees[n], root.begin, root.end, nullptr);
+    }
+  }, 1);
+
+  for (size_t n = 0; n < deferred.size(); n++) {
+    const std::vector<Node>& sub = subtrees[n];
+    // the subtree's root replaces the placeholder, the rest is appended
+    uint32_t offset = (uint32_t)_nodes.size() - 1;
+    for (size_t i = 0; i < sub.size(); i++) {
+      Node node = sub[i];
+      if (node.left != no_node) {
+        node.left += offset;
+        node.right += offset;
+      }
+      if (i == 0) {
+        _nodes[deferred[n]] = node;
+      } else {
+        _nodes.push_back(node);
+      }
+    }
+  }
+}
+
+bool StarIndex::Brighter(uint32_t a, uint32_t b) const
+{
+  double ma = _entries[a].star->vmag, mb = _entries[b].star->vmag;
+  if (std::isnan(ma)) ma = INFINITY;
+  if (std::isnan(mb)) mb = INFINITY;
+  return ma != mb ? ma < mb : a < b;
+}
+
+void StarIndex::AddSubtrees(uint32_t index, unsigned depth, std::vector<uint32_t>& out) const
+{
+  const Node& node = _nodes[index];
+  if (!depth || node.left == no_node) {
+    out.push_back(index);
+    return;
+  }
+  AddSubtrees(node.left, depth - 1, out);
+  AddSubtrees(node.right, depth - 1, out);
+}
+
+void StarIndex::GetSubtrees(unsigned depth, std::vector<uint32_t>& out) const
+{
+  out.clear();
+  if (!_nodes.empty()) AddSubtrees(0, depth, out);
+}
+
+void StarIndex::Nearest(const Vector& c, size_t k, std::vector<Neighbour>& out,
+                        const Star *skip) const
+{
+  out.clear();
+  if (_nodes.empty() || k == 0) return;
+  double qc[3];
+  c.get(qc[0], qc[1], qc[2]);
+
+  // max-heap (by squared distance) of the best candidates so far
+  std::vector<Neighbour> heap;
+  heap.reserve(k + 1);
+  double worst = INFINITY;
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    const Node& node = _nodes[stack[--sp]];
+    if (BoxDist2(node, qc) > worst) continue;
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        const Entry& entry = _entries[n];
+        if (entry.star == skip) continue;
+        double d2 = (entry.pos - c).sqr();
+        if (heap.size() < k || d2 < heap.front().first) {
+          heap.emplace_back(d2, entry.star);
+          std::push_heap(heap.begin(), heap.end());
+          if (heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+          }
+          if (heap.size() == k) worst = heap.front().first;
+        }
+      }
+      continue;
+    }
+    // visit the nearer child first
+    double dl = BoxDist2(_nodes[node.left], qc);
+    double dr = BoxDist2(_nodes[node.right], qc);
+    if (dl <= dr) {
+      stack[sp++] = node.right;
+      stack[sp++] = node.left;
+    } else {
+      stack[sp++] = node.left;
+      stack[sp++] = node.right;
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end());
+  out.reserve(heap.size());
+  for (const auto& it : heap) {
+    out.emplace_back(sqrt(it.first), it.second);
+  }
+}
@@ -0,0 +1,268 @@
+#ifndef STARMAP_SPATIAL_H
+#define STARMAP_SPATIAL_H
+
+#include "maths.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Star;
+
+// Static k-d tree over points associated with stars. Usually the point is
+// the star's position, but callers may index any vector (e.g. directions).
+// Add all points, call Build() once, then run as many queries as needed.
+
+class StarIndex {
+public:
+  struct Entry {
+    Vector pos;
+    Star *star;
+  };
+
+  typedef std::pair<double, Star*> Neighbour; // (distance, star)
+
+  void Clear();
+  void Reserve(size_t count) { _entries.reserve(count); }
+  void Add(Star *star, const Vector& pos) { _entries.push_back({pos, star}); }
+  // builds the tree, using the worker pool for large inputs
+  void Build();
+
+  size_t Size() const { return _entries.size(); }
+  bool IsEmpty() const { return _entries.empty(); }
+  const std::vector<Entry>& GetEntries() const { return _entries; }
+
+  // The nodes depth levels down (or leaves above that), left to right.
+  // Queries started at each of these in turn visit the same points, in
+  // the same order, as one query over the whole tree, so they can be
+  // shared among threads.
+  void GetSubtrees(unsigned depth, std::vector<uint32_t>& out) const;
+
+  // call fn(entry) for each point inside the axis-aligned box [lo, hi],
+  // optionally only in the subtree below root
+  template<typename F> void ForEachInBox(const Vector& lo, const Vector& hi, F fn,
+                                         uint32_t root = 0) const;
+
+  // call fn(entry, squared distance) for each point within radius r of c
+  template<typename F> void ForEachInRadius(const Vector& c, double r, F fn) const;
+
+  // the tier_size brightest (by Star::vmag) of some of the stars below
+  // each node, brightest first, for level-of-detail queries
+  struct Tiers {
+    std::vector<uint32_t> entries; // tier_size slots per node
+    std::vector<uint8_t> counts;   // slots used, per node
+    void clear() { entries.clear(); counts.clear(); }
+  };
+
+  // Keeps the tiers of all the stars. Call after Build().
+  void BuildTiers() { BuildTiers(_tiers, [](const Star *) { return true; }); }
+  // Makes tiers of only the stars accept(star) is true for, such as those
+  // passing a filter, to query with instead. Must be redone if the tree
+  // is rebuilt.
+  template<typename A> void BuildTiers(Tiers& tiers, A accept) const;
+  const Tiers& GetTiers() const { return _tiers; }
+
+  // Like ForEachInBox, but a subtree no more than detail across in x and
+  // y only gives the stars of its tier, brightest first, so that the
+  // points visited are bounded by the box's area in detail-sized cells
+  // rather than by how many points it holds. Needs BuildTiers().
+  template<typename F> void ForEachInBoxLOD(const Vector& lo, const Vector& hi, double detail,
+                                            F fn, uint32_t root = 0) const {
+    ForEachInBoxLOD(lo, hi, detail, fn, _tiers, [](const Star *) { return true; }, root);
+  }
+  // the same, but only for the stars accept(star) is true for, with
+  // tiers built from the same accept
+  template<typename F, typename A>
+  void ForEachInBoxLOD(const Vector& lo, const Vector& hi, double detail, F fn,
+                       const Tiers& tiers, A accept, uint32_t root = 0) const;
+
+  // the k nearest points to c, closest first, optionally skipping one star
+  void Nearest(const Vector& c, size_t k, std::vector<Neighbour>& out,
+               const Star *skip = nullptr) const;
+
+protected:
+  static const unsigned leaf_size = 8;
+  static const unsigned tier_size = 4;
+  static const uint32_t no_node = UINT32_MAX;
+
+  struct Node {
+    double lo[3], hi[3];   // bounding box
+    uint32_t begin, end;   // range of entries
+    uint32_t left, right;  // children, or no_node for leaves
+  };
+
+  std::vector<Entry> _entries;
+  std::vector<Node> _nodes;
+  Tiers _tiers; // of all the stars
+
+  static double Coord(const Vector& v, unsigned axis) {
+    return axis == 0 ? v.get_x() : axis == 1 ? v.get_y() : v.get_z();
+  }
+  static double BoxDist2(const Node& node, const double c[3]) {
+    double d2 = 0.0;
+    for (unsigned a = 0; a < 3; a++) {
+      double d = c[a] < node.lo[a] ? node.lo[a] - c[a] :
+                 c[a] > node.hi[a] ? c[a] - node.hi[a] : 0.0;
+      d2 += d * d;
+    }
+    return d2;
+  }
+
+  // unknown magnitudes count as faintest; ties go by entry, so the
+  // tiers don't depend on anything but the tree
+  bool Brighter(uint32_t a, uint32_t b) const;
+  static bool IsCoarse(const Tiers& tiers, const double lo[3], const double hi[3],
+                       double detail) {
+    return !tiers.counts.empty() && hi[0] - lo[0] <= detail && hi[1] - lo[1] <= detail;
+  }
+
+  void AddSubtrees(uint32_t index, unsigned depth, std::vector<uint32_t>& out) const;
+  uint32_t BuildNode(std::vector<Node>& nodes, uint32_t begin, uint32_t end,
+                     std::vector<uint32_t>* deferred);
+  void SetBounds(Node& node) const;
+};
+
+template<typename F>
+void StarIndex::ForEachInBox(const Vector& lo, const Vector& hi, F fn, uint32_t root) const
+{
+  if (_nodes.empty()) return;
+  double qlo[3], qhi[3];
+  lo.get(qlo[0], qlo[1], qlo[2]);
+  hi.get(qhi[0], qhi[1], qhi[2]);
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = root;
+  while (sp) {
+    const Node& node = _nodes[stack[--sp]];
+    bool inside = true;
+    bool outside = false;
+    for (unsigned a = 0; a < 3; a++) {
+      if (node.hi[a] < qlo[a] || node.lo[a] > qhi[a]) outside = true;
+      if (node.lo[a] < qlo[a] || node.hi[a] > qhi[a]) inside = false;
+    }
+    if (outside) continue;
+    if (inside || node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        const Entry& entry = _entries[n];
+        if (!inside) {
+          double x, y, z;
+          entry.pos.get(x, y, z);
+          if (x < qlo[0] || x > qhi[0] ||
+              y < qlo[1] || y > qhi[1] ||
+              z < qlo[2] || z > qhi[2]) continue;
+        }
+        fn(entry);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+template<typename A>
+void StarIndex::BuildTiers(Tiers& tiers, A accept) const
+{
+  tiers.entries.assign(_nodes.size() * tier_size, 0);
+  tiers.counts.assign(_nodes.size(), 0);
+  auto brighter = [this](uint32_t a, uint32_t b) { return Brighter(a, b); };
+
+  // Children always come after their parent, so going backwards
+  // sees both children of a node before the node itself.
+  for (size_t index = _nodes.size(); index-- > 0; ) {
+    const Node& node = _nodes[index];
+    uint32_t *tier = &tiers.entries[index * tier_size];
+    uint32_t picked[2 * tier_size > leaf_size ? 2 * tier_size : leaf_size];
+    uint32_t size = 0;
+    if (node.left == no_node) {
+      assert(node.end - node.begin <= leaf_size); // Build() splits anything bigger
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        if (accept(_entries[n].star)) picked[size++] = n;
+      }
+    } else {
+      const uint32_t *left = &tiers.entries[(size_t)node.left * tier_size];
+      const uint32_t *right = &tiers.entries[(size_t)node.right * tier_size];
+      uint32_t nleft = tiers.counts[node.left], nright = tiers.counts[node.right];
+      std::merge(left, left + nleft, right, right + nright, picked, brighter);
+      size = nleft + nright;
+    }
+    uint32_t count = size < tier_size ? size : tier_size;
+    std::partial_sort(picked, picked + count, picked + size, brighter);
+    std::copy(picked, picked + count, tier);
+    tiers.counts[index] = (uint8_t)count;
+  }
+}
+
+template<typename F, typename A>
+void StarIndex::ForEachInBoxLOD(const Vector& lo, const Vector& hi, double detail, F fn,
+                                const Tiers& tiers, A accept, uint32_t root) const
+{
+  if (_nodes.empty()) return;
+  double qlo[3], qhi[3];
+  lo.get(qlo[0], qlo[1], qlo[2]);
+  hi.get(qhi[0], qhi[1], qhi[2]);
+  auto in_box = [&](const Entry& entry) {
+    double x, y, z;
+    entry.pos.get(x, y, z);
+    return x >= qlo[0] && x <= qhi[0] && y >= qlo[1] && y <= qhi[1] && z >= qlo[2] && z <= qhi[2];
+  };
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = root;
+  while (sp) {
+    uint32_t index = stack[--sp];
+    const Node& node = _nodes[index];
+    bool outside = false;
+    for (unsigned a = 0; a < 3; a++) {
+      if (node.hi[a] < qlo[a] || node.lo[a] > qhi[a]) outside = true;
+    }
+    if (outside) continue;
+    if (IsCoarse(tiers, node.lo, node.hi, detail)) {
+      const uint32_t *tier = &tiers.entries[(size_t)index * tier_size];
+      for (uint32_t t = 0; t < tiers.counts[index]; t++) {
+        if (in_box(_entries[tier[t]])) fn(_entries[tier[t]]);
+      }
+      continue;
+    }
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        if (in_box(_entries[n]) && accept(_entries[n].star)) fn(_entries[n]);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+template<typename F>
+void StarIndex::ForEachInRadius(const Vector& c, double r, F fn) const
+{
+  if (_nodes.empty()) return;
+  double qc[3];
+  c.get(qc[0], qc[1], qc[2]);
+  double r2 = r * r;
+
+  uint32_t stack[64];
+  unsigned sp = 0;
+  stack[sp++] = 0;
+  while (sp) {
+    const Node& node = _nodes[stack[--sp]];
+    if (BoxDist2(node, qc) > r2) continue;
+    if (node.left == no_node) {
+      for (uint32_t n = node.begin; n < node.end; n++) {
+        const Entry& entry = _entries[n];
+        double d2 = (entry.pos - c).sqr();
+        if (d2 <= r2) fn(entry, d2);
+      }
+      continue;
+    }
+    stack[sp++] = node.right;
+    stack[sp++] = node.left;
+  }
+}
+
+#endif //STARMAP_SPATIAL_H
@@ -1,6 +1,10 @@
 #include "starlist.h"
 
 std::list<Star*> stars;
+std::list<Star*> dir_stars;
+std::vector<Star*> star_table;
+StarIndex star_index;
+SkyIndex sky_index;
 
 void Star::sort_names()
 {
@@ -14,3 +18,44 @@ bool Star::has_name(const wxString& name)
   }
   return false;
 }
+
+// a function, so that it's there before any other file's statics use it
+static std::vector<void (*)()>& index_hooks()
+{
+  static std::vector<void (*)()> hooks;
+  return hooks;
+}
+
+bool on_index_stars(void (*fn)())
+{
+  index_hooks().push_back(fn);
+  return true;
+}
+
+wxString star_label(const Star *star)
+{
+  return star->names.empty() ? wxString(wxT("(unnamed)")) : star->names.front().name;
+}
+
+void index_stars()
+{
+  star_table.assign(stars.begin(), stars.end());
+  star_index.Clear();
+  star_index.Reserve(star_table.size());
+  for (size_t n = 0; n < star_table.size(); n++) {
+    Star *star = star_table[n];
+    star->id = (unsigned)n;
+    star_index.Add(star, star->get_pos());
+  }
+  star_index.Build();
+  star_index.BuildTiers();
+
+  sky_index.Clear();
+  sky_index.Reserve(dir_stars.size());
+  for (Star *star : dir_stars) {
+    sky_index.Add(star, star->get_pos());
+  }
+  sky_index.Build();
+
+  for (auto fn : index_hooks()) fn();
+}
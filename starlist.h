@@ -2,7 +2,10 @@
 #define STARMAP_STARLIST_H
 
 #include "maths.h"
+#include "sky.h"
+#include "spatial.h"
 #include <list>
+#include <vector>
 #include <wx/colour.h>
 #include <wx/gdicmn.h>
 #include <wx/string.h>
@@ -22,12 +25,19 @@ public:
   bool is3d;
   std::list<StarName> names;
   int comp;
+  unsigned catalogs; // bitmask of the catalogs this star was found in
+  unsigned id;       // position in star_table (3D stars only)
 
   Vector pos;     // star coordinates (parsecs, heliocentric)
+  Vector motion;  // change of pos per year (parsecs, or radians if !is3d)
+  double epoch;   // year for which pos applies
+  bool has_motion; // whether motion includes the proper motion
   wxPoint proj;   // current projection point
   bool show;      // current visibility
   wxCoord tw, th; // text extents
   bool te;        // text extents
+  wxPoint label;  // where the name is drawn,
+  bool labelled;  // if it found room
 
   double vmag;    // visual magnitude
   wxString type;  // spectral type
@@ -37,13 +47,35 @@ public:
 
   wxString remarks; // remarks
 
-  Star(): te(FALSE) {}
+  Star(): epoch(2000.0), has_motion(FALSE), show(FALSE), te(FALSE), labelled(FALSE) {}
   void sort_names();
   bool has_name(const wxString& name);
 
   const Vector& get_pos() const { return pos; }
 };
 
-extern std::list<Star*> stars;
+// the star's first name, for lists and messages
+wxString star_label(const Star *star);
+
+extern std::list<Star*> stars;     // stars with known positions
+extern std::list<Star*> dir_stars; // stars with only a known direction
+
+// the star list as an array, indexed by Star::id
+extern std::vector<Star*> star_table;
+
+// spatial index over the positions of all stars in the star list
+extern StarIndex star_index;
+
+// sky index over the directions of all direction-only stars
+extern SkyIndex sky_index;
+
+// (re)build star_table, star_index and sky_index,
+// call whenever the star lists have changed
+void index_stars();
+
+// Has fn called at the end of every index_stars(), to drop whatever a
+// module derived from the old star lists. Meant for initialising a
+// static flag with, so it returns true.
+bool on_index_stars(void (*fn)());
 
 #endif //STARMAP_STARLIST_H
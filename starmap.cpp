@@ -1,12 +1,45 @@
 #include "starmap.h"
 #include "starlist.h"
 #include "import.h"
+#include "panels.h"
+#include "groups.h"
+#include "distance.h"
+#include "territory.h"
+#include "kinetic.h"
+#include "parallel.h"
+#include <algorithm>
 #include <wx/dcclient.h>
 #include <wx/menu.h>
 #include <wx/msgdlg.h>
 #include <wx/rawbmp.h>
+#include <wx/stopwatch.h>
 #include <wx/textdlg.h>
 
+// half the thickness of the slab shown by the density overlay, around
+// the depth of the view's centre, parsecs
+#define DENSITY_SLAB 10.0
+
+// the catalog epoch, and how far from its base epoch the
+// moving-star index is used before it's rebuilt (years)
+#define BASE_EPOCH 2000.0
+#define KINETIC_WINDOW 5000.0
+
+// the worker pool culls the view in 2^CULL_DEPTH pieces of the star
+// index, and draws the stars in tiles of RENDER_TILE pixels square
+#define CULL_DEPTH 6
+#define RENDER_TILE 64
+
+// memory kept for rasterised star names, bytes, and the time
+// allowed for finding room for the names in a frame, ms
+#define LABEL_CACHE_BYTES (16 << 20)
+#define LABEL_BUDGET 10
+
+// with level of detail on, at most LOD_CELL_STARS stars, and
+// LOD_CELL_NAMES of their names, are shown per LOD_CELL pixels square
+#define LOD_CELL 16
+#define LOD_CELL_STARS 6
+#define LOD_CELL_NAMES 1
+
 #define APP_QUIT    100
 #define APP_ABOUT   101
 #define APP_NAMES   201
@@ -14,8 +47,27 @@
 #define APP_LINES   203
 #define APP_COLORS  204
 #define APP_FLIP    205
+#define APP_COLOR_SPECTRAL 206
+#define APP_COLOR_REACH    207
+#define APP_JUMP    208
+#define APP_COLOR_GROUP    209
+#define APP_DENSITY_NONE   210
+#define APP_DENSITY_COUNT  211
+#define APP_DENSITY_LIGHT  212
+#define APP_COLOR_DISTANCE 213
+#define APP_SHELL   214
+#define APP_COLOR_TERRITORY 215
+#define APP_SEEDS   216
+#define APP_EPOCH   217
+#define APP_ORTHO   218
+#define APP_LOD     219
 #define APP_SEARCH  300
 #define APP_FILTER  301
+#define APP_NEAREST 302
+#define APP_ROUTE   303
+#define APP_APPROACH 304
+#define APP_GROUPS  305
+#define APP_DISTANCES 306
 
 // some informative stuff
 
@@ -68,13 +120,26 @@ bool StarApp::OnInit(void)
   frame->Show(TRUE);
   SetTopWindow(frame);
 
-  import_all();
+  // merging stars by position, in addition to names, is optional
+  bool crossmatch = false;
+  for (int i = 1; i < argc; i++) {
+    if (wxString(argv[i]) == wxT("--crossmatch")) crossmatch = true;
+  }
+
+  import_all(crossmatch);
 
   return TRUE;
 }
 
 StarFrame::StarFrame(wxFrame *frame, const char *title, int x, int y, int w, int h)
-  : wxFrame(frame, -1, title, wxPoint(x, y), wxSize(w, h))
+  : wxFrame(frame, -1, title, wxPoint(x, y), wxSize(w, h)),
+    nearest((NeighbourPanel *)NULL),
+    routes((RoutePanel *)NULL),
+    approaches((ApproachPanel *)NULL),
+    groups((GroupPanel *)NULL),
+    filters((FilterPanel *)NULL),
+    searcher((SearchPanel *)NULL),
+    distances((DistancePanel *)NULL)
 {
   canvas = new StarCanvas(this);
 
@@ -88,8 +153,35 @@ StarFrame::StarFrame(wxFrame *frame, const char *title, int x, int y, int w, int
   option_menu->Append(APP_LINES,  "&Lines", "Show lines to galactic plane", TRUE);
   option_menu->Append(APP_COLORS, "&Colors", "Show colors", TRUE);
   option_menu->Append(APP_FLIP,   "Fli&p", "Rotate 180 degrees around X axis", TRUE);
+  option_menu->Append(APP_ORTHO,  "&Orthographic", "Show the map flat, without perspective", TRUE);
+  option_menu->Append(APP_LOD,    "Level of &detail", "Show only the brightest stars where they crowd together", TRUE);
+  wxMenu *color_menu = new wxMenu;
+  color_menu->AppendRadioItem(APP_COLOR_SPECTRAL, "&Spectral class", "Color stars by spectral class");
+  color_menu->AppendRadioItem(APP_COLOR_REACH, "&Jumps from reference",
+                              "Color stars by the number of jumps needed to reach them");
+  color_menu->AppendRadioItem(APP_COLOR_GROUP, "&Moving group", "Color stars by moving group");
+  color_menu->AppendRadioItem(APP_COLOR_DISTANCE, "&Distance from reference",
+                              "Color stars by distance shell around the reference star");
+  color_menu->AppendRadioItem(APP_COLOR_TERRITORY, "&Territory",
+                              "Color stars by the nearest seed star (shift-click to pick seeds)");
+  option_menu->AppendSubMenu(color_menu, "Color &by");
+  wxMenu *density_menu = new wxMenu;
+  density_menu->AppendRadioItem(APP_DENSITY_NONE, "&None", "No density overlay");
+  density_menu->AppendRadioItem(APP_DENSITY_COUNT, "Star &count", "Shade the grid plane by the number of stars near it");
+  density_menu->AppendRadioItem(APP_DENSITY_LIGHT, "&Luminosity", "Shade the grid plane by the total luminosity near it");
+  option_menu->AppendSubMenu(density_menu, "&Density");
+  option_menu->Append(APP_JUMP,   "&Jump range...", "Set the maximum jump distance");
+  option_menu->Append(APP_SHELL,  "&Shell width...", "Set the width of the distance shells");
+  option_menu->Append(APP_SEEDS,  "Clear &territories", "Remove all territory seed stars");
+  option_menu->Append(APP_EPOCH,  "Display &epoch...", "Draw the stars where they were or will be in another year (the tools keep the catalog positions)");
   wxMenu *view_menu = new wxMenu;
   view_menu->Append(APP_SEARCH,"&Search", "Find star names");
+  view_menu->Append(APP_FILTER,"&Filter", "Only show stars with selected properties");
+  view_menu->Append(APP_NEAREST,"&Nearest stars", "List the stars nearest to the reference star");
+  view_menu->Append(APP_DISTANCES,"&Distances", "List all stars by distance from the reference star");
+  view_menu->Append(APP_ROUTE,  "&Route", "Plan a route with limited jump distance");
+  view_menu->Append(APP_APPROACH,"&Close approaches", "Find stars that pass close to the Sun or another star");
+  view_menu->Append(APP_GROUPS, "&Moving groups", "Find groups of stars that move together");
   wxMenu *help_menu = new wxMenu;
   help_menu->Append(APP_ABOUT, "&About", "About Starmap");
   menu_bar = new wxMenuBar;
@@ -112,7 +204,27 @@ BEGIN_EVENT_TABLE(StarFrame, wxFrame)
   EVT_MENU(APP_LINES, StarFrame::Option)
   EVT_MENU(APP_COLORS,StarFrame::Option)
   EVT_MENU(APP_FLIP,  StarFrame::Option)
+  EVT_MENU(APP_ORTHO, StarFrame::Option)
+  EVT_MENU(APP_LOD,   StarFrame::Option)
+  EVT_MENU(APP_COLOR_SPECTRAL, StarFrame::ColorBy)
+  EVT_MENU(APP_COLOR_REACH, StarFrame::ColorBy)
+  EVT_MENU(APP_COLOR_GROUP, StarFrame::ColorBy)
+  EVT_MENU(APP_COLOR_DISTANCE, StarFrame::ColorBy)
+  EVT_MENU(APP_COLOR_TERRITORY, StarFrame::ColorBy)
+  EVT_MENU(APP_DENSITY_NONE, StarFrame::Option)
+  EVT_MENU(APP_DENSITY_COUNT, StarFrame::Option)
+  EVT_MENU(APP_DENSITY_LIGHT, StarFrame::Option)
+  EVT_MENU(APP_JUMP,  StarFrame::JumpRange)
+  EVT_MENU(APP_SHELL, StarFrame::ShellWidth)
+  EVT_MENU(APP_SEEDS, StarFrame::ClearSeeds)
+  EVT_MENU(APP_EPOCH, StarFrame::Epoch)
   EVT_MENU(APP_SEARCH,StarFrame::Search)
+  EVT_MENU(APP_FILTER,StarFrame::Filter)
+  EVT_MENU(APP_NEAREST,StarFrame::Nearest)
+  EVT_MENU(APP_DISTANCES,StarFrame::Distances)
+  EVT_MENU(APP_ROUTE, StarFrame::Route)
+  EVT_MENU(APP_APPROACH,StarFrame::Approaches)
+  EVT_MENU(APP_GROUPS,StarFrame::Groups)
   EVT_SIZE(StarFrame::OnSize)
   EVT_CLOSE(StarFrame::OnCloseWindow)
 END_EVENT_TABLE()
@@ -128,33 +240,155 @@ void StarFrame::About(wxCommandEvent& WXUNUSED(event) )
                      wxT("About Starmap"), wxOK|wxCENTRE);
 }
 
-void StarFrame::Option(wxCommandEvent& WXUNUSED(event) )
+void StarFrame::Option(wxCommandEvent& event)
 {
-  canvas->Redraw();
+  // only redraw what the option affects
+  switch (event.GetId()) {
+  case APP_NAMES:  canvas->Redraw(LAYER_NAMES); break;
+  case APP_LINES:  canvas->Redraw(LAYER_LINES); break;
+  case APP_COLORS: canvas->Redraw(LAYER_STARS); break;
+  case APP_FLIP:   canvas->Redraw(LAYER_VIEW); break;
+  case APP_ORTHO:  canvas->Redraw(LAYER_VIEW); break;
+  case APP_LOD:    canvas->Redraw(LAYER_VIEW); break;
+  default:         canvas->Redraw(LAYER_BACKGROUND); break; // grid, density
+  }
 }
 
-void StarFrame::Search(wxCommandEvent& WXUNUSED(event) )
+void StarFrame::ColorBy(wxCommandEvent& WXUNUSED(event) )
 {
-  wxString str = wxGetTextFromUser("Star name", "Search", "", this);
+  if (menu_bar->IsChecked(APP_COLOR_REACH)) canvas->color_mode = COLOR_REACH;
+  else if (menu_bar->IsChecked(APP_COLOR_GROUP)) canvas->color_mode = COLOR_GROUP;
+  else if (menu_bar->IsChecked(APP_COLOR_DISTANCE)) canvas->color_mode = COLOR_DISTANCE;
+  else if (menu_bar->IsChecked(APP_COLOR_TERRITORY)) canvas->color_mode = COLOR_TERRITORY;
+  else canvas->color_mode = COLOR_SPECTRAL;
+  canvas->UpdateReach();
+  // territory borders are only drawn when coloring by territory
+  canvas->Redraw(LAYER_BACKGROUND);
+}
 
-  if (str.IsEmpty()) {
-    // wxMessageBox("Nothing entered.", "Search", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+void StarFrame::SetColorMode(ColorMode mode)
+{
+  switch (mode) {
+  case COLOR_SPECTRAL: menu_bar->Check(APP_COLOR_SPECTRAL, TRUE); break;
+  case COLOR_REACH:    menu_bar->Check(APP_COLOR_REACH, TRUE); break;
+  case COLOR_GROUP:    menu_bar->Check(APP_COLOR_GROUP, TRUE); break;
+  case COLOR_DISTANCE: menu_bar->Check(APP_COLOR_DISTANCE, TRUE); break;
+  case COLOR_TERRITORY: menu_bar->Check(APP_COLOR_TERRITORY, TRUE); break;
+  }
+  canvas->color_mode = mode;
+  canvas->UpdateReach();
+  canvas->Redraw(LAYER_BACKGROUND);
+}
+
+void StarFrame::JumpRange(wxCommandEvent& WXUNUSED(event) )
+{
+  wxString str = wxGetTextFromUser("Maximum jump (ly)", "Jump range",
+                                   wxString::Format("%g", canvas->reach_jump * LIGHTYEAR_PER_PARSEC),
+                                   this);
+  double ly;
+  if (str.IsEmpty()) return;
+  if (!str.ToDouble(&ly) || ly <= 0.0) {
+    wxMessageBox("Invalid jump distance.", "Jump range", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
     return;
   }
+  canvas->reach_jump = ly / LIGHTYEAR_PER_PARSEC;
+  canvas->UpdateReach();
+  canvas->Redraw(LAYER_STARS);
+}
 
-  SetStatusText("Searching...");
-  for (const auto star : stars) {
-    for (const auto &nit : star->names) {
-      if (nit.name.Find(str) >= 0) {
-        // found a match, center on it
-        canvas->pos = Vector(-star->pos.get_x(), -star->pos.get_y(), canvas->pos.depth());
-        canvas->Redraw();
-        return;
-      }
-    }
+void StarFrame::ShellWidth(wxCommandEvent& WXUNUSED(event) )
+{
+  wxString str = wxGetTextFromUser("Distance shell width (ly)", "Shell width",
+                                   wxString::Format("%g", canvas->shell_width * LIGHTYEAR_PER_PARSEC),
+                                   this);
+  double ly;
+  if (str.IsEmpty()) return;
+  if (!str.ToDouble(&ly) || ly <= 0.0) {
+    wxMessageBox("Invalid shell width.", "Shell width", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+    return;
   }
-  SetStatusText("Ready.");
-  wxMessageBox("No match found.", "Search", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+  canvas->shell_width = ly / LIGHTYEAR_PER_PARSEC;
+  canvas->Redraw(LAYER_STARS);
+}
+
+void StarFrame::ClearSeeds(wxCommandEvent& WXUNUSED(event) )
+{
+  territories.Clear();
+  canvas->Redraw(LAYER_BACKGROUND);
+}
+
+void StarFrame::Epoch(wxCommandEvent& WXUNUSED(event) )
+{
+  wxString str = wxGetTextFromUser("Draw stars as of year (negative for BC)", "Display epoch",
+                                   wxString::Format("%g", canvas->epoch),
+                                   this);
+  double year;
+  if (str.IsEmpty()) return;
+  if (!str.ToDouble(&year)) {
+    wxMessageBox("Invalid year.", "Display epoch", wxOK|wxCENTRE|wxICON_EXCLAMATION, this);
+    return;
+  }
+  canvas->epoch = year;
+  canvas->Redraw();
+}
+
+void StarFrame::Search(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!searcher) searcher = new SearchPanel(this);
+  searcher->Show(TRUE);
+  searcher->Raise();
+  searcher->Focus();
+}
+
+void StarFrame::Filter(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!filters) filters = new FilterPanel(this);
+  filters->Show(TRUE);
+  filters->Raise();
+}
+
+void StarFrame::Nearest(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!nearest) nearest = new NeighbourPanel(this);
+  nearest->Show(TRUE);
+  nearest->Raise();
+  nearest->RefChanged();
+}
+
+void StarFrame::Distances(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!distances) distances = new DistancePanel(this);
+  distances->Show(TRUE);
+  distances->Raise();
+  distances->RefChanged();
+}
+
+void StarFrame::Route(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!routes) routes = new RoutePanel(this);
+  if (!routes->IsShown()) routes->Prefill();
+  routes->Show(TRUE);
+  routes->Raise();
+}
+
+void StarFrame::Approaches(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!approaches) approaches = new ApproachPanel(this);
+  approaches->Show(TRUE);
+  approaches->Raise();
+}
+
+void StarFrame::Groups(wxCommandEvent& WXUNUSED(event) )
+{
+  if (!groups) groups = new GroupPanel(this);
+  groups->Show(TRUE);
+  groups->Raise();
+}
+
+void StarFrame::RefChanged()
+{
+  if (nearest) nearest->RefChanged();
+  if (distances) distances->RefChanged();
 }
 
 void StarFrame::OnSize(wxSizeEvent& WXUNUSED(event) )
@@ -171,17 +405,35 @@ StarCanvas::StarCanvas(wxFrame *parent)
   : wxWindow(parent, -1),
     pos(0, 0, 35), // 35 parsec away from standard galactic plane
     refpos(0, 0, SOL_Z_OFFSET), // use Sol's position as initial ref
+    refstar((const Star *)NULL),
     pitch(0),
     zoom(1.0),
+    epoch(BASE_EPOCH),
     need_realloc(FALSE),
     need_render(FALSE),
     need_paint(FALSE),
-    ready(FALSE)
+    ready(FALSE),
+    dirty(LAYER_VIEW),
+    ortho(FALSE),
+    lod(FALSE),
+    labels(LABEL_CACHE_BYTES),
+    name_reach(0),
+    filtering(FALSE),
+    tiered(nullptr),
+    color_mode(COLOR_SPECTRAL),
+    reach_jump(8.0 / LIGHTYEAR_PER_PARSEC),
+    shell_width(5.0 / LIGHTYEAR_PER_PARSEC)
 {
   SetBackgroundColour(*wxBLACK);
   SetCursor(*wxCROSS_CURSOR);
 }
 
+StarCanvas::~StarCanvas()
+{
+  // the reach search calls back into the canvas
+  reach.Stop();
+}
+
 BEGIN_EVENT_TABLE(StarCanvas, wxWindow)
   EVT_SIZE(StarCanvas::OnSize)
   EVT_CHAR(StarCanvas::OnChar)
@@ -205,20 +457,16 @@ void StarCanvas::OnChar(wxKeyEvent& event)
   double factor = event.ControlDown() ? 10.0 : 1.0;
   switch(event.GetKeyCode()) {
   case WXK_LEFT:
-    pos += Vector(+zoom/20.0, 0.0, 0.0) * factor;
-    Redraw();
+    Pan(+zoom/20.0 * factor, 0.0);
     break;
   case WXK_RIGHT:
-    pos += Vector(-zoom/20.0, 0.0, 0.0) * factor;
-    Redraw();
+    Pan(-zoom/20.0 * factor, 0.0);
     break;
   case WXK_UP:
-    pos += Vector(0.0, flip ? -zoom/20.0 : +zoom/20.0, 0.0) * factor;
-    Redraw();
+    Pan(0.0, (flip ? -zoom/20.0 : +zoom/20.0) * factor);
     break;
   case WXK_DOWN:
-    pos += Vector(0.0, flip ? +zoom/20.0 : -zoom/20.0, 0.0) * factor;
-    Redraw();
+    Pan(0.0, (flip ? +zoom/20.0 : -zoom/20.0) * factor);
     break;
   case WXK_PAGEUP:
     pos += Vector(0.0, 0.0, -zoom/2.0) * factor;
@@ -246,55 +494,96 @@ void StarCanvas::OnChar(wxKeyEvent& event)
     zoom *= 1.1;
     Redraw();
     break;
+  case '[':
+    epoch -= 1000.0 * factor;
+    Redraw();
+    break;
+  case ']':
+    epoch += 1000.0 * factor;
+    Redraw();
+    break;
   default:
     event.Skip();
   }
 }
 
+// Moves the camera along the plane. An unpitched orthographic view is
+// moved by whole pixels, so that the picture can just be scrolled.
+void StarCanvas::Pan(double dx, double dy)
+{
+  if (ortho && ready && !need_realloc && dirty > LAYER_VIEW && pitch.rad() == 0.0) {
+    wxSize siz(GetClientSize());
+    double factor = sqrt(siz.GetX()*siz.GetX() + siz.GetY()*siz.GetY())*4.0 / zoom;
+    double scale = factor / std::max(pos.depth(), 0.1); // as in SetupView
+    int px = (int)lround(dx * scale), py = (int)lround(dy * scale);
+    if (px || py) {
+      pos += Vector(px / scale, py / scale, 0.0);
+      scroll += wxPoint(px, menu_bar->IsChecked(APP_FLIP) ? -py : py);
+      ClearDescs();
+      need_render = TRUE;
+      return;
+    }
+  }
+  pos += Vector(dx, dy, 0.0);
+  Redraw();
+}
+
 void StarCanvas::OnKeyDown(wxKeyEvent& event)
 {
   event.Skip();
 }
 
-void StarCanvas::OnMotion(wxMouseEvent& event)
+bool StarCanvas::PickStars(const wxPoint& pt)
 {
   int mdist = 19, xd, yd, td;
+  bool any = FALSE;
+
+  // gather the stars in the grid cells around the pointer, and go
+  // through them in drawing order, so that ties come out as before
+  picks.clear();
+  pick_grid.ForEachNear(pt, 3, [&](unsigned n) { picks.push_back(n); });
+  std::sort(picks.begin(), picks.end());
+
+  // find closest star(s) to pointer
+  select.clear();
+  for (unsigned n : picks) {
+    const auto star = visible[n];
+    xd = star->proj.x - pt.x;
+    if (xd < 0) xd = -xd;
+    yd = star->proj.y - pt.y;
+    if (yd < 0) yd = -yd;
+
+    if ((xd < 4) && (yd < 4)) {
+      td = xd*xd + yd*yd;
+
+      if (td < mdist) {
+	// closer star, clear list and select this
+	mdist = td;
+	select.clear();
+	select.push_back(star);
+	any = TRUE;
+      }
+      else if (td == mdist) {
+	// star at same distance, add it to list
+	select.push_back(star);
+	any = TRUE;
+      }
+    }
+  }
+  return any;
+}
+
+void StarCanvas::OnMotion(wxMouseEvent& event)
+{
   bool any, was;
 
   if (!ready) return;
 
-  any = FALSE;
   was = !descs.empty();
   descpt.x = event.GetX();
   descpt.y = event.GetY();
 
-  // find closest star(s) to pointer
-  select.clear();
-  for (const auto star : stars) {
-    if (star->show) {
-      xd = star->proj.x - descpt.x;
-      if (xd < 0) xd = -xd;
-      yd = star->proj.y - descpt.y;
-      if (yd < 0) yd = -yd;
-
-      if ((xd < 4) && (yd < 4)) {
-	td = xd*xd + yd*yd;
-
-	if (td < mdist) {
-	  // closer star, clear list and select this
-	  mdist = td;
-	  select.clear();
-	  select.push_back(star);
-	  any = TRUE;
-	}
-	else if (td == mdist) {
-	  // star at same distance, add it to list
-	  select.push_back(star);
-	  any = TRUE;
-	}
-      }
-    }
-  }
+  any = PickStars(descpt);
 
   // create descriptions
   CreateDescs();
@@ -306,19 +595,31 @@ void StarCanvas::OnLeaveWindow(wxMouseEvent& WXUNUSED(event) )
 {
   // if cursor left window, remove descriptions
   if (!descs.empty())
-    Redraw();
+    Repaint(TRUE);
 }
 
-void StarCanvas::OnLeftDown(wxMouseEvent& WXUNUSED(event) )
+void StarCanvas::OnLeftDown(wxMouseEvent& event)
 {
-  // left button click sets the reference point to selected star
-  if (!select.empty()) {
+  if (!ready) return;
+
+  // left button click sets the reference point to selected star,
+  // shift-click makes it a territory seed (or stops it being one)
+  PickStars(wxPoint(event.GetX(), event.GetY()));
+  if (!select.empty() && event.ShiftDown()) {
+    territories.Toggle(select.front());
+    ((StarFrame *)GetParent())->SetColorMode(COLOR_TERRITORY);
+  } else if (!select.empty()) {
     const auto star = select.front();
     refpos = star->pos;
+    refstar = star;
 
     // recreate descriptions
     CreateDescs();
     Repaint(FALSE);
+    ((StarFrame *)GetParent())->RefChanged();
+    UpdateReach();
+    if (color_mode == COLOR_DISTANCE) Redraw(LAYER_STARS);
+    if (filtering && !std::isinf(filter.max_dist)) UpdateFilter();
   }
 }
 
@@ -347,227 +648,793 @@ static wxColour::ChannelType BlendComponent(wxColour::ChannelType a,
 #endif
 }
 
-static void BlendPixel(wxNativePixelData::Iterator& pixel, const wxColour& color, bool colors)
+static void BlendPixel(wxNativePixelData::Iterator& pixel, const StarRGB& color, bool colors)
 {
   if (colors) {
-    pixel.Red()   = BlendComponent(pixel.Red(),   color.Red());
-    pixel.Green() = BlendComponent(pixel.Green(), color.Green());
-    pixel.Blue()  = BlendComponent(pixel.Blue(),  color.Blue());
+    pixel.Red()   = BlendComponent(pixel.Red(),   color.red);
+    pixel.Green() = BlendComponent(pixel.Green(), color.green);
+    pixel.Blue()  = BlendComponent(pixel.Blue(),  color.blue);
   } else {
-    pixel.Red()   = color.Red();
-    pixel.Green() = color.Green();
-    pixel.Blue()  = color.Blue();
+    pixel.Red()   = color.red;
+    pixel.Green() = color.green;
+    pixel.Blue()  = color.blue;
   }
 }
 
-void StarCanvas::RenderStars()
+// the pixels a line from p1 to p2 can touch
+static wxRect line_box(const wxPoint& p1, const wxPoint& p2)
+{
+  return wxRect(std::min(p1.x, p2.x), std::min(p1.y, p2.y),
+                abs(p2.x - p1.x) + 1, abs(p2.y - p1.y) + 1);
+}
+
+// colors for 0, 1, 2, ... jumps or distance shells; stars further away use the last one
+static const unsigned char hop_colors[][3] = {
+  {255, 255, 255}, {80, 255, 80}, {180, 255, 60}, {255, 255, 60}, {255, 200, 40},
+  {255, 140, 40}, {255, 80, 60}, {255, 60, 160}, {200, 80, 255}, {120, 100, 255}
+};
+
+// colors for moving groups and territories, reused if there are more
+static const unsigned char group_colors[][3] = {
+  {255, 80, 80}, {80, 200, 255}, {255, 220, 60}, {120, 255, 120}, {255, 120, 255},
+  {255, 160, 60}, {140, 140, 255}, {60, 255, 220}, {220, 255, 100}, {255, 100, 170}
+};
+
+StarRGB StarCanvas::StarColor(const Star *star, bool colors) const
+{
+  if (color_mode == COLOR_REACH) {
+    int hops = reach.GetHops(star);
+    if (hops < 0) return {70, 70, 70};
+    const unsigned n = sizeof(hop_colors) / sizeof(hop_colors[0]);
+    const unsigned char *rgb = hop_colors[std::min((unsigned)hops, n - 1)];
+    return {rgb[0], rgb[1], rgb[2]};
+  }
+  if (color_mode == COLOR_DISTANCE) {
+    float dist = ref_distances.Get(star);
+    if (std::isnan(dist)) return {70, 70, 70};
+    const unsigned n = sizeof(hop_colors) / sizeof(hop_colors[0]);
+    const unsigned char *rgb = hop_colors[(unsigned)std::min(dist / shell_width, n - 1.0)];
+    return {rgb[0], rgb[1], rgb[2]};
+  }
+  if (color_mode == COLOR_TERRITORY) {
+    int slot = territories.GetTerritory(star);
+    if (slot < 0) return {70, 70, 70};
+    const unsigned n = sizeof(group_colors) / sizeof(group_colors[0]);
+    const unsigned char *rgb = group_colors[slot % n];
+    return {rgb[0], rgb[1], rgb[2]};
+  }
+  if (color_mode == COLOR_GROUP) {
+    int group = moving_groups.GetGroup(star);
+    if (group < 0) return {70, 70, 70};
+    const unsigned n = sizeof(group_colors) / sizeof(group_colors[0]);
+    const unsigned char *rgb = group_colors[group % n];
+    return {rgb[0], rgb[1], rgb[2]};
+  }
+  if (!colors) return {255, 255, 255};
+  return {star->color.Red(), star->color.Green(), star->color.Blue()};
+}
+
+void StarCanvas::UpdateReach()
+{
+  if (color_mode != COLOR_REACH) {
+    reach.Cancel();
+    return;
+  }
+  // the search runs in the background, and each finished level
+  // triggers a new render from the UI thread
+  reach.Start(GetRefStar(), reach_jump, [this]() {
+    CallAfter(&StarCanvas::ReachProgress);
+  });
+}
+
+void StarCanvas::UpdateFilter()
+{
+  if (filtering) {
+    filter.ref = refpos;
+    selection.Apply(filter);
+    tiered = nullptr;
+  }
+  Redraw();
+}
+
+void StarCanvas::ReachProgress()
+{
+  Redraw(LAYER_STARS);
+}
+
+// draws those of the shown stars (visible, or some of it in drawing
+// order) that touch area, clipped to it
+void StarCanvas::RenderStars(const wxRect& area, const std::vector<Star*>& shown)
 {
   bool colors = menu_bar->IsChecked(APP_COLORS);
+  // a no-op unless the reference or the star list changed
+  if (color_mode == COLOR_DISTANCE) ref_distances.Update(refpos);
   dc->SelectObject(wxNullBitmap);
   {
     wxNativePixelData data(*bmp);
-    auto pixels = data.GetPixels();
-    for (const auto star: stars) {
-      if (star->show &&
-          star->proj.y > 1 && star->proj.y < data.GetHeight() - 1 &&
-          star->proj.x > 1 && star->proj.x < data.GetWidth() - 1) {
-        wxColour color = colors ? star->color : *wxWHITE;
-        pixels.MoveTo(data, star->proj.x, star->proj.y - 1);
-        BlendPixel(pixels, color, colors);
-        pixels.MoveTo(data, star->proj.x - 1, star->proj.y);
-        BlendPixel(pixels, color, colors);
-        pixels++;
-        BlendPixel(pixels, color, colors);
-        pixels++;
-        BlendPixel(pixels, color, colors);
-        pixels.MoveTo(data, star->proj.x, star->proj.y + 1);
-        BlendPixel(pixels, color, colors);
+    const int width = data.GetWidth(), height = data.GetHeight();
+    const int cols = (width + RENDER_TILE - 1) / RENDER_TILE;
+    const int rows = (height + RENDER_TILE - 1) / RENDER_TILE;
+    const size_t tiles = (size_t)cols * rows, count = shown.size();
+
+    // Sort the stars into the tiles they touch, keeping them in drawing
+    // order within each tile, so that every pixel is blended in the same
+    // order whichever threads draw it. Each block of stars counts its
+    // share of every tile, then fills in its part of the tile's list.
+    const size_t blocks = std::min<size_t>(64, (count + 1023) / 1024);
+    std::vector<StarRGB> rgb(count);
+    std::vector<size_t> slot(blocks * tiles, 0), tile_start(tiles + 1);
+    const int left = area.GetLeft(), right = area.GetRight();
+    const int top = area.GetTop(), bottom = area.GetBottom();
+    auto for_each_tile = [&](const Star *star, auto fn) {
+      // the star is a cross three pixels wide, and must fit on screen
+      const wxPoint& p = star->proj;
+      if (p.y <= 1 || p.y >= height - 1 || p.x <= 1 || p.x >= width - 1) return;
+      if (p.x + 1 < left || p.x - 1 > right || p.y + 1 < top || p.y - 1 > bottom) return;
+      for (int ty = (p.y - 1) / RENDER_TILE; ty <= (p.y + 1) / RENDER_TILE; ty++) {
+        for (int tx = (p.x - 1) / RENDER_TILE; tx <= (p.x + 1) / RENDER_TILE; tx++) {
+          fn((size_t)ty * cols + tx);
+        }
+      }
+    };
+    parallel_for(blocks, [&](size_t begin, size_t end) {
+      for (size_t b = begin; b < end; b++) {
+        size_t *counts = &slot[b * tiles];
+        for (size_t n = count * b / blocks; n < count * (b + 1) / blocks; n++) {
+          rgb[n] = StarColor(shown[n], colors);
+          for_each_tile(shown[n], [&](size_t t) { counts[t]++; });
+        }
+      }
+    }, 1);
+    size_t total = 0;
+    for (size_t t = 0; t < tiles; t++) {
+      tile_start[t] = total;
+      for (size_t b = 0; b < blocks; b++) {
+        size_t c = slot[b * tiles + t];
+        slot[b * tiles + t] = total;
+        total += c;
       }
     }
+    tile_start[tiles] = total;
+    std::vector<unsigned> tile_stars(total);
+    parallel_for(blocks, [&](size_t begin, size_t end) {
+      for (size_t b = begin; b < end; b++) {
+        size_t *next = &slot[b * tiles];
+        for (size_t n = count * b / blocks; n < count * (b + 1) / blocks; n++) {
+          for_each_tile(shown[n], [&](size_t t) { tile_stars[next[t]++] = (unsigned)n; });
+        }
+      }
+    }, 1);
+
+    // draw each tile's stars, clipped to the tile and the area
+    parallel_for(tiles, [&](size_t begin, size_t end) {
+      auto pixels = data.GetPixels();
+      for (size_t t = begin; t < end; t++) {
+        int x0 = (int)(t % cols) * RENDER_TILE, y0 = (int)(t / cols) * RENDER_TILE;
+        int x1 = std::min(x0 + RENDER_TILE, right + 1), y1 = std::min(y0 + RENDER_TILE, bottom + 1);
+        x0 = std::max(x0, left);
+        y0 = std::max(y0, top);
+        auto plot = [&](int x, int y, const StarRGB& color) {
+          if (x < x0 || x >= x1 || y < y0 || y >= y1) return;
+          pixels.MoveTo(data, x, y);
+          BlendPixel(pixels, color, colors);
+        };
+        for (size_t i = tile_start[t]; i < tile_start[t + 1]; i++) {
+          unsigned n = tile_stars[i];
+          const wxPoint& p = shown[n]->proj;
+          plot(p.x, p.y - 1, rgb[n]);
+          plot(p.x - 1, p.y, rgb[n]);
+          plot(p.x, p.y, rgb[n]);
+          plot(p.x + 1, p.y, rgb[n]);
+          plot(p.x, p.y + 1, rgb[n]);
+        }
+      }
+    }, 1);
   }
   dc->SelectObject(*bmp);
 }
 
-void StarCanvas::RenderView()
+void StarCanvas::RenderDensity(DensityMeasure measure, const Transform& cam, const Vector& center,
+                               double xview, double yview, double factor, int mx, int my)
 {
+  // the slab around the point the view is centred on; the density map
+  // keeps it by layer, so panning reuses it
+  const wxImage& slab = density_map.GetSlab(measure, center.get_z() - DENSITY_SLAB,
+                                            center.get_z() + DENSITY_SLAB);
+  const double cell = DensityMap::cell;
+  double ox = density_map.GetOriginX(), oy = density_map.GetOriginY();
+  int cols = density_map.GetColumns(), rows = density_map.GetRows();
   wxSize siz(GetClientSize());
-  wxRect rect(wxPoint(0, 0), siz);
-  wxRegion area(rect);
-  double factor = sqrt(siz.GetX()*siz.GetX() + siz.GetY()*siz.GetY())*4.0 / zoom;
-  int mx = siz.GetX()/2, my = siz.GetY()/2;
-  bool names = menu_bar->IsChecked(APP_NAMES);
-  bool grid = menu_bar->IsChecked(APP_GRID);
-  bool lines = menu_bar->IsChecked(APP_LINES);
-  bool flip = menu_bar->IsChecked(APP_FLIP);
 
-  if (!bmp || need_realloc) {
-    bmp = std::make_unique<wxBitmap>(siz.GetX(), siz.GetY(), 24);
-    dc = std::make_unique<wxMemoryDC>();
-    dc->SelectObject(*bmp);
-    need_realloc = FALSE;
+  if (pitch.rad() != 0.0) {
+    // Tilted view, draw each cell under the shown part of the map.
+    int cx1 = std::max(0, (int)floor((center.get_x() - xview - ox) / cell));
+    int cx2 = std::min(cols, (int)ceil((center.get_x() + xview - ox) / cell));
+    int cy1 = std::max(0, (int)floor((center.get_y() - yview - oy) / cell));
+    int cy2 = std::min(rows, (int)ceil((center.get_y() + yview - oy) / cell));
+    dc->SetPen(*wxTRANSPARENT_PEN);
+    for (int cy = cy1; cy < cy2; cy++) {
+      for (int cx = cx1; cx < cx2; cx++) {
+        wxColour color(slab.GetRed(cx, cy), slab.GetGreen(cx, cy), slab.GetBlue(cx, cy));
+        if (!color.Red() && !color.Green() && !color.Blue()) continue;
+        Vector c[4] = {
+          Vector(ox + cx * cell, oy + cy * cell, 0.0) * cam,
+          Vector(ox + (cx + 1) * cell, oy + cy * cell, 0.0) * cam,
+          Vector(ox + (cx + 1) * cell, oy + (cy + 1) * cell, 0.0) * cam,
+          Vector(ox + cx * cell, oy + (cy + 1) * cell, 0.0) * cam
+        };
+        wxPoint p[4];
+        if (!ToScreen(c[0], factor, mx, my, p[0]) || !ToScreen(c[1], factor, mx, my, p[1]) ||
+            !ToScreen(c[2], factor, mx, my, p[2]) || !ToScreen(c[3], factor, mx, my, p[3])) continue;
+        dc->SetBrush(wxBrush(color));
+        dc->DrawPolygon(4, p);
+      }
+    }
+    return;
+  }
+
+  // The plane faces the camera, so the cells are squares lined up with
+  // the screen, and a scaled copy of the slab can be reused while panning.
+  Vector corner = Vector(ox, oy, 0.0) * cam;
+  Vector across = Vector(ox + cell, oy + cell, 0.0) * cam;
+  double depth = ortho ? 1.0 : corner.get_z(); // factor is already per parsec if orthographic
+  double sx = corner.get_x() / depth * factor + mx;
+  double sy = corner.get_y() / depth * factor + my;
+  double px = (across.get_x() > corner.get_x() ? 1.0 : -1.0) * cell * factor / depth;
+  double py = (across.get_y() > corner.get_y() ? 1.0 : -1.0) * cell * factor / depth;
+
+  // cells on screen
+  double fx1 = -sx / px, fx2 = (siz.GetX() - sx) / px;
+  double fy1 = -sy / py, fy2 = (siz.GetY() - sy) / py;
+  int cx1 = std::max(0, (int)floor(std::min(fx1, fx2)));
+  int cx2 = std::min(cols, (int)ceil(std::max(fx1, fx2)));
+  int cy1 = std::max(0, (int)floor(std::min(fy1, fy2)));
+  int cy2 = std::min(rows, (int)ceil(std::max(fy1, fy2)));
+  if (cx1 >= cx2 || cy1 >= cy2) return;
+
+  if (!density_bmp || density_gen != density_map.GetGeneration() ||
+      fabs(density_px - px) > 1e-9 * fabs(px) || fabs(density_py - py) > 1e-9 * fabs(py) ||
+      cx1 < density_cells.GetLeft() || cx2 > density_cells.GetRight() + 1 ||
+      cy1 < density_cells.GetTop() || cy2 > density_cells.GetBottom() + 1) {
+    // scale up the visible cells, plus some margin to pan into
+    int margin_x = (cx2 - cx1) / 4 + 1, margin_y = (cy2 - cy1) / 4 + 1;
+    int left = std::max(0, cx1 - margin_x), right = std::min(cols, cx2 + margin_x);
+    int top = std::max(0, cy1 - margin_y), bottom = std::min(rows, cy2 + margin_y);
+    density_cells = wxRect(left, top, right - left, bottom - top);
+    wxImage part = slab.GetSubImage(density_cells);
+    if (px < 0.0) part = part.Mirror(TRUE);
+    if (py < 0.0) part = part.Mirror(FALSE);
+    part = part.Scale((int)(density_cells.GetWidth() * fabs(px) + 0.5),
+                      (int)(density_cells.GetHeight() * fabs(py) + 0.5));
+    density_bmp = std::make_unique<wxBitmap>(part);
+    density_gen = density_map.GetGeneration();
+    density_px = px;
+    density_py = py;
   }
 
-  dc->SetBackground(*wxBLACK_BRUSH);
-  dc->Clear();
+  // screen position of the bitmap's top left corner
+  double left = sx + (px > 0.0 ? density_cells.GetLeft() : density_cells.GetRight() + 1) * px;
+  double top = sy + (py > 0.0 ? density_cells.GetTop() : density_cells.GetBottom() + 1) * py;
+  dc->DrawBitmap(*density_bmp, (wxCoord)floor(left + 0.5), (wxCoord)floor(top + 0.5));
+}
 
-  Transform cam(pitch, Angle(), Angle(),
-                Vector(pos.get_x(), pos.get_y(), 0.0),
-                Vector(0.0, 0.0, pos.get_z()),
-                flip);
-  Vector campos = cam.invert_translate();
-  Vector center = cam.get_forward_z() != 0.0 ?
-      campos - cam.get_forward() * (campos.get_z() / cam.get_forward_z()) :
+void StarCanvas::RenderTerritories(const Transform& cam, double z, double factor, int mx, int my,
+                                   const wxRect& area)
+{
+  const auto& slice = territories.GetSlice(z);
+  const unsigned n = sizeof(group_colors) / sizeof(group_colors[0]);
+  dc->SetBrush(*wxTRANSPARENT_BRUSH);
+  for (size_t slot = 0; slot < slice.size(); slot++) {
+    const auto& poly = slice[slot];
+    const unsigned char *rgb = group_colors[slot % n];
+    dc->SetPen(wxPen(wxColour(rgb[0] / 2, rgb[1] / 2, rgb[2] / 2)));
+    for (size_t v = 0; v < poly.size(); v++) {
+      wxPoint p1, p2;
+      if (!ToScreen(poly[v] * cam, factor, mx, my, p1) ||
+          !ToScreen(poly[(v + 1) % poly.size()] * cam, factor, mx, my, p2)) continue;
+      if (!area.Intersects(line_box(p1, p2))) continue;
+      dc->DrawLine(p1.x, p1.y, p2.x, p2.y);
+    }
+  }
+
+  // ring the seeds themselves
+  for (const Star *seed : territories.GetSeeds()) {
+    if (!seed) continue;
+    wxPoint p;
+    if (!ToScreen(ViewPos(seed) * cam, factor, mx, my, p)) continue;
+    if (!area.Intersects(wxRect(p.x - 6, p.y - 6, 13, 13))) continue;
+    dc->SetPen(*wxWHITE_PEN);
+    dc->DrawCircle(p.x, p.y, 5);
+  }
+  dc->SetPen(*wxTRANSPARENT_PEN);
+}
+
+void StarCanvas::SetupView(ViewSetup& view)
+{
+  wxSize siz(GetClientSize());
+  bool flip = menu_bar->IsChecked(APP_FLIP);
+
+  view.factor = sqrt(siz.GetX()*siz.GetX() + siz.GetY()*siz.GetY())*4.0 / zoom;
+  view.mx = siz.GetX()/2;
+  view.my = siz.GetY()/2;
+  view.cam = Transform(pitch, Angle(), Angle(),
+                       Vector(pos.get_x(), pos.get_y(), 0.0),
+                       Vector(0.0, 0.0, pos.get_z()),
+                       flip);
+  Vector campos = view.cam.invert_translate();
+  view.center = view.cam.get_forward_z() != 0.0 ?
+      campos - view.cam.get_forward() * (campos.get_z() / view.cam.get_forward_z()) :
       Vector(pos.get_x(), pos.get_y(), 0.0);
+  view.depth = pos.depth();
+  view.scale = view.factor;
+  double height = pos.get_z();
+
+  if (ortho) {
+    // Show the plane as a perspective view would at the camera's height.
+    // Until the view changes, the camera of the last full render is used,
+    // with the picture moved by whole pixels, so that panning can scroll it.
+    view.depth = std::max(view.depth, 0.1);
+    view.scale = view.factor / view.depth;
+    height = view.depth;
+    if (dirty <= LAYER_VIEW) {
+      ortho_cam = view.cam;
+      ortho_shift = wxPoint(0, 0);
+    }
+    view.cam = ortho_cam;
+    view.mx += ortho_shift.x;
+    view.my += ortho_shift.y;
+  }
+
+  // With level of detail on, parts of the index that would fit in a
+  // screen cell only show their brightest stars (of those that pass,
+  // when filtering).
+  view.detail = 0.0;
+  if (lod && view.depth > 0.0) view.detail = LOD_CELL * view.depth / view.factor;
 
   // view that's approximately equivalent to drawn grid
-  double xview = siz.GetX() / (factor * 2.0) * pos.get_z() + 2.0 / LIGHTYEAR_PER_PARSEC;
-  double yview = siz.GetY() / (factor * 2.0) * pos.get_z() + 2.0 / LIGHTYEAR_PER_PARSEC;
+  view.xview = siz.GetX() / (view.factor * 2.0) * height + 2.0 / LIGHTYEAR_PER_PARSEC;
+  view.yview = siz.GetY() / (view.factor * 2.0) * height + 2.0 / LIGHTYEAR_PER_PARSEC;
+}
 
-  // update frame's status bar
-  wxFrame *frame = (wxFrame *)GetParent();
-  frame->SetStatusText("Drawing...", 0);
-  {
-    wxString ptext;
-    double px, py, pz;
-    pos.get(px, py, pz);
-    ptext.Printf("(%+.2f,%+.2f,%+.2f) x%.2f",
-		 // use units which seem natural for the user
-		 -px * LIGHTYEAR_PER_PARSEC,
-		 -py * LIGHTYEAR_PER_PARSEC,
-		 pz * LIGHTYEAR_PER_PARSEC,
-		 1.0 / zoom);
-    frame->SetStatusText(ptext, 1);
+// where a point in camera space lands on screen; false if it's behind the camera
+bool StarCanvas::ToScreen(const Vector& v, double scale, int mx, int my, wxPoint& p) const
+{
+  if (ortho) {
+    p = v.oproject(scale, mx, my);
+    return TRUE;
+  }
+  if (v.behind()) return FALSE;
+  p = v.pproject(scale, mx, my);
+  return TRUE;
+}
+
+void StarCanvas::CullView(const ViewSetup& view, const Vector& lo, const Vector& hi,
+                          const wxRect& area)
+{
+  wxSize siz(GetClientSize());
+  Projector projector(view.cam, view.scale, view.mx, view.my, siz.GetX(), siz.GetY(), ortho);
+
+  // only render stars that would be on the displayed grid,
+  // even if the view is tilted, as this keeps the display readable
+  // (and if the user really wants to see more stars, they can always
+  // change Z position, or zoom out); the workers each take subtrees
+  // of the index, and the pieces are put back together in order, so
+  // the result doesn't depend on the number of threads
+  bool moved = epoch != BASE_EPOCH;
+  // stepping through time only rebuilds the index now and then
+  if (moved && !kinetic_index.Covers(epoch)) {
+    kinetic_index.Build(epoch, KINETIC_WINDOW);
+    if (tiered == &kinetic_index) tiered = nullptr;
+  }
+  const StarIndex& index = moved ? (const StarIndex&)kinetic_index : star_index;
+  index.GetSubtrees(CULL_DEPTH, subtrees);
+  auto selected = [&](const Star *star) {
+    return !filtering || selection.IsSelected(star->id);
+  };
+  // a filter gets tiers of its own, so that culling stays bounded by
+  // the screen however few of the stars pass it
+  if (filtering && view.detail > 0.0 && tiered != &index) {
+    index.BuildTiers(filter_tiers, selected);
+    tiered = &index;
+  }
+  const StarIndex::Tiers& tiers = filtering ? filter_tiers : index.GetTiers();
+  pieces.resize(subtrees.size());
+  parallel_for(subtrees.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      ProjectionBatch& piece = pieces[n];
+      piece.Clear();
+      auto place = [&](Star *star, const Vector& p) {
+        if (filtering && !selection.IsSelected(star->id)) return;
+        piece.Add(star, p);
+      };
+      auto place_entry = [&](const StarIndex::Entry& entry) {
+        place(entry.star, entry.star->get_pos());
+      };
+      auto place_moved = [&](const StarIndex::Entry& entry, const Vector& p) {
+        place(entry.star, p);
+      };
+      if (!moved && view.detail > 0.0) {
+        star_index.ForEachInBoxLOD(lo, hi, view.detail, place_entry, tiers, selected,
+                                   subtrees[n]);
+      } else if (!moved) {
+        star_index.ForEachInBox(lo, hi, place_entry, subtrees[n]);
+      } else if (view.detail > 0.0) {
+        kinetic_index.ForEachInBoxLOD(lo, hi, epoch, view.detail, place_moved, tiers, selected,
+                                      subtrees[n]);
+      } else {
+        kinetic_index.ForEachInBox(lo, hi, epoch, place_moved, subtrees[n]);
+      }
+      piece.Project(projector);
+    }
+  }, 1);
+  for (const auto& piece : pieces) {
+    for (size_t n = 0; n < piece.Size(); n++) {
+      if (!piece.visible[n] || !area.Contains(piece.sx[n], piece.sy[n])) continue;
+      Star *star = piece.stars[n];
+      star->proj = wxPoint(piece.sx[n], piece.sy[n]);
+      star->show = TRUE;
+      star->labelled = FALSE;
+      visible.push_back(star);
+    }
+  }
+}
+
+// the level-of-detail cell at p, on a screen cols x rows cells large
+static size_t lod_cell(const wxPoint& p, int cols, int rows)
+{
+  int cx = std::min(std::max(p.x / LOD_CELL, 0), cols - 1);
+  int cy = std::min(std::max(p.y / LOD_CELL, 0), rows - 1);
+  return (size_t)cy * cols + cx;
+}
+
+// unknown magnitudes count as faintest
+static bool brighter(const Star *a, const Star *b)
+{
+  double ma = std::isnan(a->vmag) ? INFINITY : a->vmag;
+  double mb = std::isnan(b->vmag) ? INFINITY : b->vmag;
+  return ma < mb;
+}
+
+// Thins out the stars from visible[first] on, brightest first, so that
+// no screen cell has more than LOD_CELL_STARS stars, counting those
+// before first. The rest keep their drawing order.
+void StarCanvas::CapCells(size_t first)
+{
+  wxSize siz(GetClientSize());
+  int cols = (siz.GetX() + LOD_CELL - 1) / LOD_CELL, rows = (siz.GetY() + LOD_CELL - 1) / LOD_CELL;
+  auto cell = [&](const Star *star) { return lod_cell(star->proj, cols, rows); };
+  std::vector<unsigned> counts((size_t)cols * rows, 0);
+  for (size_t n = 0; n < first; n++) counts[cell(visible[n])]++;
+
+  std::vector<Star*> order(visible.begin() + first, visible.end());
+  std::stable_sort(order.begin(), order.end(), brighter);
+  for (Star *star : order) {
+    unsigned& count = counts[cell(star)];
+    if (count < LOD_CELL_STARS) count++;
+    else star->show = FALSE;
+  }
+  visible.erase(std::remove_if(visible.begin() + first, visible.end(),
+                               [](const Star *star) { return !star->show; }),
+                visible.end());
+}
+
+void StarCanvas::UpdatePickGrid()
+{
+  // bucket the shown stars by screen position, for mouse picking
+  wxSize siz(GetClientSize());
+  pick_grid.Reset(siz.GetX(), siz.GetY(), 8);
+  for (size_t n = 0; n < visible.size(); n++) {
+    pick_grid.Add(visible[n]->proj, (unsigned)n);
+  }
+}
+
+// draws what's under the stars, or the part of it that crosses area
+void StarCanvas::RenderBackground(const ViewSetup& view, const wxRect& area)
+{
+  wxSize siz(GetClientSize());
+  bool grid = menu_bar->IsChecked(APP_GRID);
+  // a perspective camera below the plane sees none of it
+  bool plane = ortho || !pos.behind();
+
+  // draw density overlay, behind everything else
+  if (plane && !menu_bar->IsChecked(APP_DENSITY_NONE)) {
+    RenderDensity(menu_bar->IsChecked(APP_DENSITY_LIGHT) ? DENSITY_LUMINOSITY : DENSITY_COUNT,
+                  view.cam, view.center, view.xview, view.yview, view.scale, view.mx, view.my);
   }
 
   // draw grid
-  if (grid && !pos.behind()) {
-    double fac = factor / LIGHTYEAR_PER_PARSEC / pos.depth();
+  if (plane && grid) {
+    double fac = view.factor / LIGHTYEAR_PER_PARSEC / view.depth;
     // select a somewhat decent grid factor
     if (fac < 10) fac *= 2;
     if (fac < 10) fac *= 5;
 
-    double rfac = fac * pos.depth() / factor;
+    double rfac = fac * view.depth / view.factor;
     int xdivs = siz.GetX() / (fac * 2.0) + 2;
     int ydivs = siz.GetY() / (fac * 2.0) + 2;
-    double yfov = siz.GetY() / (factor * 2.0);
+    double yfov = siz.GetY() / (view.factor * 2.0);
 
-    Vector grid_pos = center - Vector(fmod(center.get_x(), rfac), fmod(center.get_y(), rfac), 0.0);
+    Vector grid_pos = view.center - Vector(fmod(view.center.get_x(), rfac),
+                                           fmod(view.center.get_y(), rfac), 0.0);
 
     // draw grid with gray pen
     dc->SetPen(*wxGREY_PEN);
 
     for (int x = -xdivs; x <= xdivs; x++) {
-      Vector v1 = (Vector(x, -ydivs, 0.0) * rfac + grid_pos) * cam;
-      Vector v2 = (Vector(x, ydivs, 0.0) * rfac + grid_pos) * cam;
-
-      // Sort vectors so lower Y is first, so that the
-      // clipping code has fewer cases to handle.
-      if (v1.get_y() > v2.get_y()) {
-        Vector tmp = v1; v1 = v2; v2 = tmp;
-      }
+      Vector v1 = (Vector(x, -ydivs, 0.0) * rfac + grid_pos) * view.cam;
+      Vector v2 = (Vector(x, ydivs, 0.0) * rfac + grid_pos) * view.cam;
+      Vector c1 = v1, c2 = v2;
+
+      if (!ortho) {
+        // Sort vectors so lower Y is first, so that the
+        // clipping code has fewer cases to handle.
+        if (v1.get_y() > v2.get_y()) {
+          Vector tmp = v1; v1 = v2; v2 = tmp;
+        }
 
-      // Clip to view frustum
-      Vector delta = v2 - v1, c1 = v1, c2 = v2;
-      if (v1.get_y() < -v1.get_z() * yfov) {
-        c1 = Vector::interpolate(v1, v2,
-                                 -(v1.get_y() + v1.get_z() * yfov) /
-                                 (delta.get_y() + delta.get_z() * yfov));
-      }
-      if (v2.get_y() > v2.get_z() * yfov) {
-        c2 = Vector::interpolate(v1, v2,
-                                 -(v1.get_y() - v1.get_z() * yfov) /
-                                 (delta.get_y() - delta.get_z() * yfov));
+        // Clip to view frustum
+        Vector delta = v2 - v1;
+        c1 = v1;
+        c2 = v2;
+        if (v1.get_y() < -v1.get_z() * yfov) {
+          c1 = Vector::interpolate(v1, v2,
+                                   -(v1.get_y() + v1.get_z() * yfov) /
+                                   (delta.get_y() + delta.get_z() * yfov));
+        }
+        if (v2.get_y() > v2.get_z() * yfov) {
+          c2 = Vector::interpolate(v1, v2,
+                                   -(v1.get_y() - v1.get_z() * yfov) /
+                                   (delta.get_y() - delta.get_z() * yfov));
+        }
       }
 
-      if (c1.behind() || c2.behind()) continue;
-
-      wxPoint p1 = c1.pproject(factor, mx, my);
-      wxPoint p2 = c2.pproject(factor, mx, my);
+      wxPoint p1, p2;
+      if (!ToScreen(c1, view.scale, view.mx, view.my, p1) ||
+          !ToScreen(c2, view.scale, view.mx, view.my, p2)) continue;
+      if (!area.Intersects(line_box(p1, p2))) continue;
       dc->DrawLine(p1.x, p1.y, p2.x, p2.y);
     }
 
     for (int y = -ydivs; y <= ydivs; y++) {
-      Vector v1 = (Vector(-xdivs, y, 0.0) * rfac + grid_pos) * cam;
-      Vector v2 = (Vector(xdivs, y, 0.0) * rfac + grid_pos) * cam;
+      Vector v1 = (Vector(-xdivs, y, 0.0) * rfac + grid_pos) * view.cam;
+      Vector v2 = (Vector(xdivs, y, 0.0) * rfac + grid_pos) * view.cam;
 
       // Since we don't currently allow rotation about Y axis,
       // we don't need a full-featured clip here.
-      if (v1.behind() || v2.behind()) continue;
-
-      wxPoint p1 = v1.pproject(factor, mx, my);
-      wxPoint p2 = v2.pproject(factor, mx, my);
+      wxPoint p1, p2;
+      if (!ToScreen(v1, view.scale, view.mx, view.my, p1) ||
+          !ToScreen(v2, view.scale, view.mx, view.my, p2)) continue;
+      if (!area.Intersects(line_box(p1, p2))) continue;
       dc->DrawLine(p1.x, p1.y, p2.x, p2.y);
     }
   }
 
-  // first pass, calculate positions
-  {
-    double x1 = center.get_x() - xview, x2 = center.get_x() + xview,
-           y1 = center.get_y() - yview, y2 = center.get_y() + yview;
-    for (const auto star: stars) {
-      // only render stars that would be on the displayed grid,
-      // even if the view is tilted, as this keeps the display readable
-      // (and if the user really wants to see more stars, they can always
-      // change Z position, or zoom out)
-      if (star->get_pos().get_x() < x1 || star->get_pos().get_x() > x2 ||
-          star->get_pos().get_y() < y1 || star->get_pos().get_y() > y2) {
-        star->show = FALSE;
-        continue;
-      }
-      Vector np = star->get_pos() * cam;
-      if (np.behind()) {
-        star->show = FALSE;
-        continue;
-      }
-      star->proj = np.pproject(factor, mx, my);
-      star->show = area.Contains(star->proj) != wxOutRegion;
+  // draw territory borders where they cross the plane
+  if (plane && color_mode == COLOR_TERRITORY && !territories.IsEmpty()) {
+    RenderTerritories(view.cam, view.center.get_z(), view.scale, view.mx, view.my, area);
+  }
+}
+
+// Finds room for the names of the stars from visible[first] on, around
+// those already placed for the stars before it. The brightest stars go
+// first, then the most prominent names; once the frame's time for this
+// is up, the rest are left out.
+void StarCanvas::PlaceNames(size_t first)
+{
+  wxStopWatch timer;
+  wxSize siz(GetClientSize());
+  placer.Reset(siz.GetX(), siz.GetY());
+  if (first == 0) name_reach = 0;
+  for (size_t n = 0; n < first; n++) {
+    const Star *star = visible[n];
+    if (star->labelled) placer.Occupy(wxRect(star->label, wxSize(star->tw, star->th)));
+  }
+
+  label_order.clear();
+  for (size_t n = first; n < visible.size(); n++) {
+    Star *star = visible[n];
+    star->labelled = FALSE;
+    if (!star->names.empty()) label_order.push_back(star);
+  }
+  std::stable_sort(label_order.begin(), label_order.end(), [](const Star *a, const Star *b) {
+    if (brighter(a, b) || brighter(b, a)) return brighter(a, b);
+    return a->names.front().priority < b->names.front().priority;
+  });
+
+  // with level of detail on, only so many names per cell
+  int cols = (siz.GetX() + LOD_CELL - 1) / LOD_CELL, rows = (siz.GetY() + LOD_CELL - 1) / LOD_CELL;
+  auto cell = [&](const Star *star) { return lod_cell(star->proj, cols, rows); };
+  std::vector<unsigned> counts;
+  if (lod) {
+    counts.assign((size_t)cols * rows, 0);
+    for (size_t n = 0; n < first; n++) {
+      if (visible[n]->labelled) counts[cell(visible[n])]++;
     }
   }
 
-  // draw names (before the stars themselves, so the stars come on top)
-  if (names) {
-    dc->SetFont(*wxSMALL_FONT);
-    dc->SetBackgroundMode(wxTRANSPARENT);
-    dc->SetTextForeground(*wxGREEN);
-    for (const auto star : stars) {
-      if (star->show && !star->names.empty()) {
-        const auto &nit = star->names.front();
-        if (!star->te) {
-          dc->GetTextExtent(nit.name, &star->tw, &star->th);
-          star->te = TRUE;
-        }
-        if (star->comp) // binary/trinary star systems or something?
-          dc->DrawText(nit.name, star->proj.x - star->tw/2, star->proj.y + star->th * (star->comp - 2));
-        else
-          dc->DrawText(nit.name, star->proj.x - star->tw/2, star->proj.y - star->th);
-      }
+  for (size_t n = 0; n < label_order.size(); n++) {
+    // rasterising new names takes most of the time, so look at the clock often
+    if (n % 16 == 0 && timer.Time() > LABEL_BUDGET) break;
+    Star *star = label_order[n];
+    if (lod && counts[cell(star)] >= LOD_CELL_NAMES) continue;
+    if (!star->te) {
+      const LabelCache::Label& label = labels.Get(star, star->names.front().name, *wxSMALL_FONT);
+      star->tw = label.width;
+      star->th = label.height;
+      star->te = TRUE;
+    }
+    int x = star->proj.x, y = star->proj.y, w = star->tw, h = star->th;
+    // where it used to go, then around the star
+    wxRect candidates[] = {
+      star->comp ? // binary/trinary star systems or something?
+        wxRect(x - w/2, y + h * (star->comp - 2), w, h) : wxRect(x - w/2, y - h, w, h),
+      wxRect(x + 3, y - h/2, w, h),     // right
+      wxRect(x - 3 - w, y - h/2, w, h), // left
+      wxRect(x - w/2, y + 2, w, h),     // below
+      wxRect(x + 2, y - h - 1, w, h),   // above right
+      wxRect(x - 2 - w, y - h - 1, w, h), // above left
+      wxRect(x + 2, y + 2, w, h),       // below right
+      wxRect(x - 2 - w, y + 2, w, h)    // below left
+    };
+    int at = placer.Place(candidates, sizeof(candidates) / sizeof(candidates[0]));
+    if (at < 0) continue;
+    star->label = candidates[at].GetTopLeft();
+    star->labelled = TRUE;
+    name_reach = std::max(name_reach, std::max(std::max(x - star->label.x, star->label.x + w - x),
+                                               std::max(y - star->label.y, star->label.y + h - y)));
+    if (lod) counts[cell(star)]++;
+  }
+}
+
+// names are drawn before the stars themselves, so the stars come on top
+// (each name is rasterised once, then blended in from the label cache)
+void StarCanvas::RenderNames(const wxRect& area, const std::vector<Star*>& shown)
+{
+  std::vector<std::pair<const LabelCache::Label*, wxPoint>> named;
+  for (const auto star : shown) {
+    if (!star->labelled) continue;
+    if (!area.Intersects(wxRect(star->label, wxSize(star->tw, star->th)))) continue;
+    named.emplace_back(&labels.Get(star, star->names.front().name, *wxSMALL_FONT), star->label);
+  }
+
+  dc->SelectObject(wxNullBitmap);
+  {
+    wxNativePixelData data(*bmp);
+    for (const auto& item : named) {
+      LabelCache::Draw(data, *item.first, item.second.x, item.second.y, area, *wxGREEN);
     }
   }
+  dc->SelectObject(*bmp);
+  labels.Trim();
+}
+
+void StarCanvas::RenderLines(const ViewSetup& view, const wxRect& area, const std::vector<Star*>& shown)
+{
+  wxSize siz(GetClientSize());
+  bool lines = menu_bar->IsChecked(APP_LINES);
 
-  // draw stars
   dc->SetBrush(*wxWHITE_BRUSH);
   dc->SetPen(*wxTRANSPARENT_PEN);
-  for (const auto star : stars) {
-    if (star->show) {
-      if (lines) {
-	Vector p(star->get_pos());
-	p.flatten();
-	Vector np = p * cam;
-	if (!np.behind()) {
-	  wxPoint bp = np.pproject(factor, mx, my);
-	  // if the endpoint is outside screen, don't plot it
-	  // even if the star is inside, to avoid clutter and slowdown
-	  if (area.Contains(bp) != wxOutRegion) {
-	    dc->SetPen(*wxCYAN_PEN);
-	    dc->DrawLine(bp.x, bp.y, star->proj.x, star->proj.y);
-	    dc->SetPen(*wxTRANSPARENT_PEN);
-	  }
-	}
-      }
+  if (lines) {
+    Projector projector(view.cam, view.scale, view.mx, view.my, siz.GetX(), siz.GetY(), ortho);
+    batch.Clear();
+    for (const auto star : shown) {
+      Vector p(ViewPos(star));
+      p.flatten();
+      batch.Add(star, p);
+    }
+    batch.Project(projector);
+    dc->SetPen(*wxCYAN_PEN);
+    for (size_t n = 0; n < batch.Size(); n++) {
+      // if the endpoint is outside screen, don't plot it
+      // even if the star is inside, to avoid clutter and slowdown
+      if (!batch.visible[n]) continue;
+      const Star *star = batch.stars[n];
+      if (!area.Intersects(line_box(wxPoint(batch.sx[n], batch.sy[n]), star->proj))) continue;
+      dc->DrawLine(batch.sx[n], batch.sy[n], star->proj.x, star->proj.y);
+    }
+    dc->SetPen(*wxTRANSPARENT_PEN);
+  }
+
+  // draw planned route
+  if (route.size() > 1) {
+    dc->SetPen(wxPen(wxColour(255, 200, 0), 2));
+    for (size_t n = 1; n < route.size(); n++) {
+      wxPoint p1, p2;
+      if (!ToScreen(ViewPos(route[n-1]) * view.cam, view.scale, view.mx, view.my, p1) ||
+          !ToScreen(ViewPos(route[n]) * view.cam, view.scale, view.mx, view.my, p2)) continue;
+      dc->DrawLine(p1.x, p1.y, p2.x, p2.y);
     }
+    dc->SetPen(*wxTRANSPARENT_PEN);
   }
+}
+
+void StarCanvas::RenderView()
+{
+  wxSize siz(GetClientSize());
+  wxRect screen(0, 0, siz.GetX(), siz.GetY());
+  bool names = menu_bar->IsChecked(APP_NAMES);
+  ortho = menu_bar->IsChecked(APP_ORTHO);
+  lod = menu_bar->IsChecked(APP_LOD);
+
+  if (!bmp || need_realloc) {
+    bmp = std::make_unique<wxBitmap>(siz.GetX(), siz.GetY(), 24);
+    dc = std::make_unique<wxMemoryDC>();
+    dc->SelectObject(*bmp);
+    need_realloc = FALSE;
+    for (auto& layer : layers) layer.reset();
+    dirty = LAYER_VIEW;
+  }
+
+  // panning that hasn't been drawn yet; past a screenful, start over
+  wxPoint shift = scroll;
+  scroll = wxPoint(0, 0);
+  if (abs(shift.x) >= siz.GetX() || abs(shift.y) >= siz.GetY()) dirty = LAYER_VIEW;
+  if (dirty <= LAYER_VIEW) shift = wxPoint(0, 0);
+  ortho_shift += shift;
+
+  ViewSetup view;
+  SetupView(view);
+
+  // update frame's status bar
+  wxFrame *frame = (wxFrame *)GetParent();
+  frame->SetStatusText("Drawing...", 0);
+  {
+    wxString ptext;
+    double px, py, pz;
+    pos.get(px, py, pz);
+    ptext.Printf("(%+.2f,%+.2f,%+.2f) x%.2f",
+		 // use units which seem natural for the user
+		 -px * LIGHTYEAR_PER_PARSEC,
+		 -py * LIGHTYEAR_PER_PARSEC,
+		 pz * LIGHTYEAR_PER_PARSEC,
+		 1.0 / zoom);
+    if (epoch != BASE_EPOCH) ptext += wxString::Format(" in %g", epoch);
+    frame->SetStatusText(ptext, 1);
+  }
+
+  if (shift.x || shift.y) ScrollView(view, shift);
+  // (the stars are always drawn again, unless only scrolling)
+  else if (dirty > LAYER_STARS) dirty = LAYER_STARS;
+
+  if (dirty <= LAYER_STARS) {
+    // start from the saved picture below the lowest layer that changed
+    if (dirty <= LAYER_BACKGROUND) {
+      dc->SetBackground(*wxBLACK_BRUSH);
+      dc->Clear();
+      RenderBackground(view, screen);
+      SaveLayer(LAYER_BACKGROUND, screen);
+    } else {
+      dc->DrawBitmap(*layers[dirty - 1], 0, 0);
+    }
+
+    // first pass, calculate positions
+    if (dirty <= LAYER_VIEW) {
+      for (const auto star : visible) {
+        star->show = FALSE;
+      }
+      visible.clear();
+      Vector lo(view.center.get_x() - view.xview, view.center.get_y() - view.yview, -INFINITY);
+      Vector hi(view.center.get_x() + view.xview, view.center.get_y() + view.yview, INFINITY);
+      CullView(view, lo, hi, screen);
+      if (lod) CapCells(0);
+      UpdatePickGrid();
+    }
 
-  RenderStars();
+    if (dirty <= LAYER_NAMES) {
+      if (names) {
+        PlaceNames(0);
+        RenderNames(screen, visible);
+      }
+      SaveLayer(LAYER_NAMES, screen);
+    }
+    if (dirty <= LAYER_LINES) {
+      RenderLines(view, screen, visible);
+      SaveLayer(LAYER_LINES, screen);
+    }
+    RenderStars(screen, visible);
+  }
+  dirty = LAYER_NONE;
   need_render = FALSE;
   need_paint = TRUE;
 
@@ -575,6 +1442,123 @@ void StarCanvas::RenderView()
   ready = TRUE;
 }
 
+// Moves the picture (and the saved layers) by shift, and draws what came
+// into sight. Only used for unpitched orthographic views, where the
+// screen maps straight onto the plane.
+void StarCanvas::ScrollView(const ViewSetup& view, const wxPoint& shift)
+{
+  wxSize siz(GetClientSize());
+  int w = siz.GetX(), h = siz.GetY();
+  wxRect screen(0, 0, w, h);
+  bool names = menu_bar->IsChecked(APP_NAMES);
+
+  dc->SelectObject(wxNullBitmap);
+  ScrollBitmap(bmp, shift);
+  dc->SelectObject(*bmp);
+  for (auto& layer : layers) ScrollBitmap(layer, shift);
+
+  // Move the shown stars along, dropping those that left the screen.
+  // Where they were drawn, or crosses that came too close to the edge
+  // to be drawn, has to be drawn again.
+  wxRect vacated[2]; // at the left or right, and at the top or bottom
+  wxRect inside(2, 2, w - 3, h - 3); // where crosses are drawn
+  size_t kept = 0;
+  for (const auto star : visible) {
+    wxRect gone;
+    bool drawn = inside.Contains(star->proj);
+    star->proj += shift;
+    star->label += shift;
+    if (drawn && !inside.Contains(star->proj)) {
+      gone = wxRect(star->proj.x - 1, star->proj.y - 1, 3, 3);
+    }
+    if (screen.Contains(star->proj)) {
+      visible[kept++] = star;
+    } else {
+      star->show = FALSE;
+      if (names && star->labelled) gone.Union(wxRect(star->label, wxSize(star->tw, star->th)));
+    }
+    if (!gone.IsEmpty()) vacated[star->proj.x <= 1 || star->proj.x >= w - 1 ? 0 : 1].Union(gone);
+  }
+  visible.resize(kept);
+
+  // the strips that came into sight: one across the full height at the
+  // left or right, and one across the rest of the width at the top or bottom
+  wxRect exposed[2] = {
+    wxRect(shift.x > 0 ? 0 : w + shift.x, 0, abs(shift.x), h),
+    wxRect(shift.x > 0 ? shift.x : 0, shift.y > 0 ? 0 : h + shift.y, w - abs(shift.x), abs(shift.y))
+  };
+  Transform inv = Transform(view.cam).invert();
+  for (const wxRect& strip : exposed) {
+    if (strip.IsEmpty()) continue;
+    // the part of the plane behind the strip, with a pixel to spare
+    Vector a = Vector((strip.GetLeft() - 1 - view.mx) / view.scale,
+                      (strip.GetTop() - 1 - view.my) / view.scale, 0.0) * inv;
+    Vector b = Vector((strip.GetRight() + 2 - view.mx) / view.scale,
+                      (strip.GetBottom() + 2 - view.my) / view.scale, 0.0) * inv;
+    Vector lo(std::min(a.get_x(), b.get_x()), std::min(a.get_y(), b.get_y()), -INFINITY);
+    Vector hi(std::max(a.get_x(), b.get_x()), std::max(a.get_y(), b.get_y()), INFINITY);
+    CullView(view, lo, hi, strip);
+  }
+  if (lod) CapCells(kept);
+  UpdatePickGrid();
+
+  // Names and crosses reach out of the strips from the new stars, and
+  // into them from the old ones, so redraw each strip with a margin.
+  // The new names go around those already there.
+  if (names) PlaceNames(kept);
+  int margin = (names ? name_reach : 0) + 2;
+  std::vector<wxRect> bands;
+  for (wxRect strip : exposed) {
+    if (!strip.IsEmpty()) bands.push_back(strip.Inflate(margin));
+  }
+  for (const wxRect& gone : vacated) {
+    if (!gone.IsEmpty()) bands.push_back(gone);
+  }
+  for (wxRect band : bands) {
+    band = band.Intersect(screen);
+    if (band.IsEmpty()) continue;
+    // Only stars near the band can reach into it: their names come no
+    // further than name_reach, and looking straight down, their lines to
+    // the plane have no length. Keep them in drawing order.
+    nearby.clear();
+    pick_grid.ForEachInRect(wxRect(band).Inflate(margin), [&](unsigned n) { nearby.push_back(n); });
+    std::sort(nearby.begin(), nearby.end());
+    subset.clear();
+    for (unsigned n : nearby) subset.push_back(visible[n]);
+
+    // (names and stars are drawn straight into the bitmap, and clip themselves)
+    dc->SetClippingRegion(band);
+    dc->SetBrush(*wxBLACK_BRUSH);
+    dc->SetPen(*wxTRANSPARENT_PEN);
+    dc->DrawRectangle(band.GetLeft(), band.GetTop(), band.GetWidth(), band.GetHeight());
+    RenderBackground(view, band);
+    dc->DestroyClippingRegion();
+    SaveLayer(LAYER_BACKGROUND, band);
+    if (names) RenderNames(band, subset);
+    SaveLayer(LAYER_NAMES, band);
+    dc->SetClippingRegion(band);
+    RenderLines(view, band, subset);
+    dc->DestroyClippingRegion();
+    SaveLayer(LAYER_LINES, band);
+    RenderStars(band, subset);
+  }
+}
+
+// Moves the picture in bitmap by shift; what it uncovers is left undefined.
+void StarCanvas::ScrollBitmap(std::unique_ptr<wxBitmap>& bitmap, const wxPoint& shift)
+{
+  if (!bitmap) return;
+  int w = bitmap->GetWidth(), h = bitmap->GetHeight();
+  if (!scratch || scratch->GetWidth() != w || scratch->GetHeight() != h) {
+    scratch = std::make_unique<wxBitmap>(w, h, 24);
+  }
+  {
+    wxMemoryDC from(*bitmap), to(*scratch);
+    to.Blit(shift.x, shift.y, w, h, &from, 0, 0, wxCOPY, FALSE);
+  }
+  bitmap.swap(scratch);
+}
+
 void StarCanvas::DoPaint(wxDC& pdc)
 {
   if (!ready) return;
@@ -622,18 +1606,52 @@ void StarCanvas::DoRepaint(void)
   need_paint = FALSE;
 }
 
-void StarCanvas::Redraw()
+void StarCanvas::Redraw(RenderLayer layer)
 {
-  ClearDescs();
+  // only a new view moves the stars out from under the descriptions
+  if (layer == LAYER_VIEW) ClearDescs();
+  if (layer < dirty) dirty = layer;
   need_render = TRUE;
 }
 
+void StarCanvas::SaveLayer(RenderLayer layer, const wxRect& area)
+{
+  int w = bmp->GetWidth(), h = bmp->GetHeight();
+  if (!layers[layer]) layers[layer] = std::make_unique<wxBitmap>(w, h, 24);
+  wxMemoryDC saved(*layers[layer]);
+  saved.Blit(area.GetLeft(), area.GetTop(), area.GetWidth(), area.GetHeight(),
+             dc.get(), area.GetLeft(), area.GetTop(), wxCOPY, FALSE);
+}
+
 void StarCanvas::Repaint(bool clr_desc)
 {
   if (clr_desc) ClearDescs();
   need_paint = TRUE;
 }
 
+Vector StarCanvas::ViewPos(const Star *star) const
+{
+  if (epoch == BASE_EPOCH) return star->get_pos();
+  return star->get_pos() + star->motion * (epoch - star->epoch);
+}
+
+const Star *StarCanvas::GetRefStar(void)
+{
+  if (!refstar && !star_index.IsEmpty()) {
+    // initially, the reference is a position (Sol's), not a star
+    std::vector<StarIndex::Neighbour> found;
+    star_index.Nearest(refpos, 1, found);
+    if (!found.empty() && found.front().first < 1e-6) refstar = found.front().second;
+  }
+  return refstar;
+}
+
+void StarCanvas::CenterOn(const Star *star)
+{
+  pos = Vector(-star->pos.get_x(), -star->pos.get_y(), pos.depth());
+  Redraw();
+}
+
 void StarCanvas::CreateDescs(void)
 {
   ClearDescs();
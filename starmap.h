@@ -1,14 +1,20 @@
+#include "density.h"
+#include "filter.h"
+#include "labels.h"
 #include "maths.h"
+#include "projection.h"
+#include "reach.h"
+#include "screengrid.h"
+#include "spatial.h"
 #include <list>
 #include <memory>
+#include <vector>
 #include <wx/app.h>
 #include <wx/dcmemory.h>
 #include <wx/frame.h>
 
 // some definitions
 
-#define LIGHTYEAR_PER_PARSEC 3.26
-
 // Sol is at least 14 light years above galactic plane,
 // but I'm not sure which way. For now, pretend we're
 // on the galactic plane.
@@ -40,11 +46,44 @@ class StarApp : public wxApp
   bool OnInit(void);
 };
 
+enum ColorMode {
+  COLOR_SPECTRAL, // spectral class
+  COLOR_REACH,    // jumps needed from the reference star
+  COLOR_GROUP,    // moving group
+  COLOR_DISTANCE, // distance shell around the reference star
+  COLOR_TERRITORY // territory of the nearest seed star
+};
+
+// The layers of the map, bottom to top. The picture up to each layer is
+// saved, so a change only redraws from the lowest layer it affects.
+enum RenderLayer {
+  LAYER_VIEW,       // which stars are shown where: camera, epoch, filter
+  LAYER_BACKGROUND, // density overlay, grid and territory borders
+  LAYER_NAMES,      // star names
+  LAYER_LINES,      // lines to the galactic plane, and the planned route
+  LAYER_STARS,      // the stars themselves
+  LAYER_NONE        // nothing to redraw
+};
+
 class StarCanvas;
+class NeighbourPanel;
+class RoutePanel;
+class ApproachPanel;
+class GroupPanel;
+class FilterPanel;
+class SearchPanel;
+class DistancePanel;
 class StarFrame : public wxFrame
 {
  public:
   StarCanvas *canvas;
+  NeighbourPanel *nearest;
+  RoutePanel *routes;
+  ApproachPanel *approaches;
+  GroupPanel *groups;
+  FilterPanel *filters;
+  SearchPanel *searcher;
+  DistancePanel *distances;
 
   StarFrame(wxFrame *parent, const char *title, int x, int y, int w, int h);
 
@@ -55,25 +94,98 @@ class StarFrame : public wxFrame
   void About(wxCommandEvent& event);
   void Option(wxCommandEvent& event);
   void Search(wxCommandEvent& event);
+  void Nearest(wxCommandEvent& event);
+  void Route(wxCommandEvent& event);
+  void Approaches(wxCommandEvent& event);
+  void Groups(wxCommandEvent& event);
+  void Filter(wxCommandEvent& event);
+  void Distances(wxCommandEvent& event);
+  void ColorBy(wxCommandEvent& event);
+  void JumpRange(wxCommandEvent& event);
+  void ShellWidth(wxCommandEvent& event);
+  void ClearSeeds(wxCommandEvent& event);
+  void Epoch(wxCommandEvent& event);
+
+  // called by the canvas when the reference star changes
+  void RefChanged();
+  // switch the map's color mode, and the menu with it
+  void SetColorMode(ColorMode mode);
 
   DECLARE_EVENT_TABLE()
 };
 
+// A star's color as drawn. Plain bytes rather than a wxColour, which
+// the rendering threads couldn't safely copy.
+struct StarRGB {
+  unsigned char red, green, blue;
+};
+
+// How the current frame is projected, shared by the rendering stages.
+struct ViewSetup {
+  Transform cam;
+  Vector center;       // where the view axis meets the plane
+  double factor;       // perspective scale
+  double scale;        // projection scale: factor, or pixels per parsec if orthographic
+  double depth;        // camera height the grid is spaced for
+  double xview, yview; // half the size of the shown part of the plane
+  double detail;       // subtrees this small show only their brightest stars, if > 0
+  int mx, my;          // screen position of the view axis
+};
+
 class StarCanvas : public wxWindow
 {
  public:
   Vector pos, refpos;
+  const Star *refstar; // star at refpos, if known
   Angle pitch;
   double zoom;
+  double epoch; // year the stars are drawn at; only the display follows it
   bool need_realloc, need_render, need_paint, ready;
+  RenderLayer dirty; // the lowest layer that needs redrawing
   std::unique_ptr<wxBitmap> bmp;
   std::unique_ptr<wxMemoryDC> dc;
-
+  std::unique_ptr<wxBitmap> layers[LAYER_STARS]; // the picture up to each layer
+  std::unique_ptr<wxBitmap> scratch;              // for scrolling the pictures
+  bool ortho;            // orthographic projection in the current frame
+  bool lod;              // level of detail in the current frame
+  Transform ortho_cam;   // orthographic camera as of the last full render,
+  wxPoint ortho_shift;   // and how far the picture has scrolled since
+  wxPoint scroll;        // panning not drawn yet
+
+  std::vector<Star*> visible; // stars shown in the current frame
+  std::vector<uint32_t> subtrees;      // pieces of the index to cull
+  std::vector<ProjectionBatch> pieces; // candidates for visible, by subtree
+  ProjectionBatch batch;               // for the lines to the plane
+  ScreenGrid pick_grid;       // indices into visible, by screen position
+  LabelCache labels;          // star names, ready to blend in
+  LabelPlacer placer;         // room taken by the names
+  int name_reach;             // how far any placed name reaches from its star, pixels
+  std::vector<Star*> label_order; // stars to label, most important first
+  std::vector<unsigned> nearby;   // indices into visible, for redrawing part of the picture
+  std::vector<Star*> subset;      // and those stars, in drawing order
+  std::vector<unsigned> picks;
+  std::vector<const Star*> route; // planned route, drawn over the map
+  bool filtering;        // only show the stars in selection
+  StarFilter filter;
+  StarSelection selection;
+  StarIndex::Tiers filter_tiers; // level of detail over just the selection,
+  const StarIndex *tiered;       // for this index, or null if out of date
+  ColorMode color_mode;
+  double reach_jump; // max jump for COLOR_REACH, in parsecs
+  double shell_width; // for COLOR_DISTANCE, in parsecs
+  ReachMap reach;
+
+  // density overlay, scaled for the current zoom
+  std::unique_ptr<wxBitmap> density_bmp;
+  wxRect density_cells;      // slab cells covered by density_bmp
+  double density_px, density_py; // screen pixels per cell
+  unsigned density_gen;
   std::list<const Star*> select;
   std::list<stardesc> descs;
   wxPoint descpt;
 
   StarCanvas(wxFrame *parent);
+  ~StarCanvas();
 
   void OnSize(wxSizeEvent& event);
   void OnChar(wxKeyEvent& event);
@@ -83,12 +195,38 @@ class StarCanvas : public wxWindow
   void OnLeftDown(wxMouseEvent& event);
   void OnIdle(wxIdleEvent& event);
   void OnPaint(wxPaintEvent& event);
-  void RenderStars();
+  bool PickStars(const wxPoint& pt);
+  StarRGB StarColor(const Star *star, bool colors) const;
+  void UpdateReach();
+  void UpdateFilter();
+  void ReachProgress();
+  void Pan(double dx, double dy);
+  bool ToScreen(const Vector& v, double scale, int mx, int my, wxPoint& p) const;
+  void SetupView(ViewSetup& view);
+  void CullView(const ViewSetup& view, const Vector& lo, const Vector& hi, const wxRect& area);
+  void CapCells(size_t first);
+  void UpdatePickGrid();
+  void RenderBackground(const ViewSetup& view, const wxRect& area);
+  void PlaceNames(size_t first);
+  void RenderNames(const wxRect& area, const std::vector<Star*>& shown);
+  void RenderLines(const ViewSetup& view, const wxRect& area, const std::vector<Star*>& shown);
+  void RenderStars(const wxRect& area, const std::vector<Star*>& shown);
+  void RenderDensity(DensityMeasure measure, const Transform& cam, const Vector& center,
+                     double xview, double yview, double factor, int mx, int my);
+  void RenderTerritories(const Transform& cam, double z, double factor, int mx, int my,
+                         const wxRect& area);
   void RenderView();
+  void ScrollView(const ViewSetup& view, const wxPoint& shift);
+  void ScrollBitmap(std::unique_ptr<wxBitmap>& bitmap, const wxPoint& shift);
   void DoPaint(wxDC& pdc);
   void DoRepaint(void);
-  void Redraw();
+  // redraw the map from layer up
+  void Redraw(RenderLayer layer = LAYER_VIEW);
+  void SaveLayer(RenderLayer layer, const wxRect& area);
   void Repaint(bool clr_desc = TRUE);
+  Vector ViewPos(const Star *star) const;
+  const Star *GetRefStar(void);
+  void CenterOn(const Star *star);
   void CreateDescs(void);
   void ClearDescs(void);
   wxSize CalcBox(wxDC& pdc, wxString txt, int *tabpos = (int *)NULL);
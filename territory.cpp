@@ -0,0 +1,153 @@
+#include "territory.h"
+#include "filter.h"
+#include "parallel.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <cmath>
+
+Territories territories;
+static const bool cleared = on_index_stars([]() { territories.Clear(); });
+
+// the slice polygons are clipped to this far around the seeds, parsecs
+#define SLICE_MARGIN 1000.0
+
+void Territories::Clear()
+{
+  _seeds.clear();
+  _count = 0;
+  _owner.clear();
+  _dist2.clear();
+  _slice.clear();
+  _generation++;
+}
+
+int Territories::GetTerritory(const Star *star) const
+{
+  if (!star->is3d || star->id >= _owner.size()) return -1;
+  return _owner[star->id];
+}
+
+void Territories::Toggle(const Star *star)
+{
+  if (!star->is3d) return;
+  if (!star_columns.IsBuilt()) star_columns.Build();
+  if (_owner.size() != star_columns.Size()) {
+    _owner.assign(star_columns.Size(), -1);
+    _dist2.assign(star_columns.Size(), INFINITY);
+  }
+  _generation++;
+
+  auto it = std::find(_seeds.begin(), _seeds.end(), star);
+  if (it != _seeds.end()) {
+    *it = (const Star *)NULL;
+    _count--;
+    Release(it - _seeds.begin());
+    return;
+  }
+  it = std::find(_seeds.begin(), _seeds.end(), (const Star *)NULL);
+  size_t slot = it - _seeds.begin();
+  if (it == _seeds.end()) _seeds.push_back(star);
+  else *it = star;
+  _count++;
+  Claim(slot);
+}
+
+void Territories::Claim(size_t slot)
+{
+  // a new seed can only take stars, so each star just
+  // compares its current seed with the new one
+  const StarColumns& col = star_columns;
+  unsigned id = _seeds[slot]->id;
+  const float sx = col.x[id], sy = col.y[id], sz = col.z[id];
+  parallel_for(col.Size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      float dx = col.x[n] - sx, dy = col.y[n] - sy, dz = col.z[n] - sz;
+      float d2 = dx * dx + dy * dy + dz * dz;
+      if (d2 < _dist2[n]) {
+        _dist2[n] = d2;
+        _owner[n] = (int32_t)slot;
+      }
+    }
+  }, 16384);
+}
+
+void Territories::Release(size_t slot)
+{
+  // only the stars of the removed seed need a new one
+  const StarColumns& col = star_columns;
+  std::vector<std::pair<uint32_t, unsigned>> live; // (slot, star id)
+  for (size_t s = 0; s < _seeds.size(); s++) {
+    if (_seeds[s]) live.push_back(std::make_pair((uint32_t)s, _seeds[s]->id));
+  }
+  parallel_for(col.Size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      if (_owner[n] != (int32_t)slot) continue;
+      int32_t owner = -1;
+      float best = INFINITY;
+      for (const auto& seed : live) {
+        float dx = col.x[n] - col.x[seed.second], dy = col.y[n] - col.y[seed.second],
+              dz = col.z[n] - col.z[seed.second];
+        float d2 = dx * dx + dy * dy + dz * dz;
+        if (d2 < best) {
+          best = d2;
+          owner = (int32_t)seed.first;
+        }
+      }
+      _owner[n] = owner;
+      _dist2[n] = best;
+    }
+  }, 16384);
+}
+
+const std::vector<std::vector<Vector>>& Territories::GetSlice(double z)
+{
+  if (_slice_gen == _generation && _slice_z == z) return _slice;
+  _slice_gen = _generation;
+  _slice_z = z;
+  _slice.assign(_seeds.size(), std::vector<Vector>());
+  if (!_count) return _slice;
+
+  double x1 = INFINITY, x2 = -INFINITY, y1 = INFINITY, y2 = -INFINITY;
+  for (const Star *seed : _seeds) {
+    if (!seed) continue;
+    x1 = std::min(x1, seed->pos.get_x());
+    x2 = std::max(x2, seed->pos.get_x());
+    y1 = std::min(y1, seed->pos.get_y());
+    y2 = std::max(y2, seed->pos.get_y());
+  }
+  x1 -= SLICE_MARGIN;
+  x2 += SLICE_MARGIN;
+  y1 -= SLICE_MARGIN;
+  y2 += SLICE_MARGIN;
+
+  // Within the plane, the points closer to seed i than to seed j form a
+  // half-plane, a.p <= b. Clipping a box by all of them gives the cell.
+  std::vector<Vector> poly, clipped;
+  for (size_t i = 0; i < _seeds.size(); i++) {
+    if (!_seeds[i]) continue;
+    const Vector& si = _seeds[i]->pos;
+    poly = { Vector(x1, y1, z), Vector(x2, y1, z), Vector(x2, y2, z), Vector(x1, y2, z) };
+    for (size_t j = 0; j < _seeds.size() && !poly.empty(); j++) {
+      if (j == i || !_seeds[j]) continue;
+      const Vector& sj = _seeds[j]->pos;
+      double ax = 2.0 * (sj.get_x() - si.get_x());
+      double ay = 2.0 * (sj.get_y() - si.get_y());
+      double b = sj.sqr() - si.sqr() - 2.0 * z * (sj.get_z() - si.get_z());
+      clipped.clear();
+      for (size_t n = 0; n < poly.size(); n++) {
+        const Vector& p1 = poly[n];
+        const Vector& p2 = poly[(n + 1) % poly.size()];
+        double e1 = ax * p1.get_x() + ay * p1.get_y() - b;
+        double e2 = ax * p2.get_x() + ay * p2.get_y() - b;
+        if (e1 <= 0.0) clipped.push_back(p1);
+        if ((e1 < 0.0 && e2 > 0.0) || (e1 > 0.0 && e2 < 0.0)) {
+          clipped.push_back(Vector::interpolate(p1, p2, e1 / (e1 - e2)));
+        }
+      }
+      poly.swap(clipped);
+    }
+    _slice[i] = poly;
+  }
+  return _slice;
+}
@@ -0,0 +1,52 @@
+#ifndef STARMAP_TERRITORY_H
+#define STARMAP_TERRITORY_H
+
+#include "maths.h"
+#include <cstdint>
+#include <vector>
+
+class Star;
+
+// Territories around a set of seed stars: every star belongs to the
+// nearest seed, which divides space into the cells of a 3-D Voronoi
+// diagram. Adding or removing a seed only revisits the stars that can
+// change hands, so editing the seeds stays cheap with large catalogs.
+// Seeds keep their slot (and thus their color) while others come and go.
+
+class Territories {
+public:
+  Territories(): _count(0), _generation(1), _slice_gen(0), _slice_z(0.0) {}
+
+  void Clear();
+  // make star a seed, or stop it being one
+  void Toggle(const Star *star);
+  bool IsEmpty() const { return _count == 0; }
+
+  // seeds by slot, NULL for unused slots
+  const std::vector<const Star*>& GetSeeds() const { return _seeds; }
+  // slot of the seed star belongs to, or -1
+  int GetTerritory(const Star *star) const;
+
+  // The cross-section of each territory at height z, a convex polygon
+  // per slot (empty if the territory doesn't reach that height).
+  // Cached until the seeds change or another height is asked for.
+  const std::vector<std::vector<Vector>>& GetSlice(double z);
+
+protected:
+  std::vector<const Star*> _seeds;
+  size_t _count;
+  unsigned _generation;        // bumped whenever the seeds change
+  std::vector<int32_t> _owner; // slot, by Star::id
+  std::vector<float> _dist2;   // squared distance to that seed
+
+  std::vector<std::vector<Vector>> _slice;
+  unsigned _slice_gen;
+  double _slice_z;
+
+  void Claim(size_t slot);
+  void Release(size_t slot);
+};
+
+extern Territories territories;
+
+#endif //STARMAP_TERRITORY_H
@@ -0,0 +1,495 @@
+// core_tests: checks of the non-UI code against brute force or against
+// a serial equivalent, on small synthetic star lists. Returns nonzero if
+// anything fails. With --write-query-cache FILE, it instead writes a
+// star cache with three known stars, for the starmap-query tests.
+
+#include "cache.h"
+#include "disjoint.h"
+#include "distance.h"
+#include "import.h"
+#include "kinetic.h"
+#include "neighbours.h"
+#include "parallel.h"
+#include "readbase.h"
+#include "sky.h"
+#include "spatial.h"
+#include "starlist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <wx/init.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++; \
+    } \
+  } while (0)
+
+// a catalog read from memory
+class MemoryCatalog : public ReadBase {
+public:
+  MemoryCatalog(const wxString& name, const std::vector<StarData>& records)
+    : _name(name), _records(records), _next(0) {}
+
+  wxString GetCatalogName() { return _name; }
+  bool ReadNext(StarData& data) {
+    if (_next == _records.size()) return false;
+    data = _records[_next++];
+    return true;
+  }
+
+protected:
+  wxString _name;
+  std::vector<StarData> _records;
+  size_t _next;
+};
+
+Star *add_star(const wxString& name, const Vector& pos)
+{
+  Star *star = new Star;
+  star->is3d = true;
+  star->comp = 0;
+  star->catalogs = 1;
+  star->pos = pos;
+  star->vmag = 5.0;
+  star->temp = 5000.0;
+  star->names.emplace_back(name, ReadBase::PRI_Other);
+  stars.push_back(star);
+  return star;
+}
+
+// n stars in a 200 pc cube, with motion, some of them without a magnitude
+void add_random_stars(size_t n, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> coord(-100.0, 100.0), mag(-5.0, 15.0), speed(-1e-4, 1e-4);
+  for (size_t i = 0; i < n; i++) {
+    Star *star = add_star(wxString::Format(wxT("Test %zu"), i),
+                          Vector(coord(rng), coord(rng), coord(rng)));
+    star->motion = Vector(speed(rng), speed(rng), speed(rng));
+    star->has_motion = true;
+    star->vmag = i % 17 == 0 ? NAN : mag(rng);
+  }
+}
+
+std::vector<Star*> sorted(std::vector<Star*> list)
+{
+  std::sort(list.begin(), list.end());
+  return list;
+}
+
+bool in_box(const Vector& p, const Vector& lo, const Vector& hi)
+{
+  return p.get_x() >= lo.get_x() && p.get_x() <= hi.get_x() &&
+         p.get_y() >= lo.get_y() && p.get_y() <= hi.get_y() &&
+         p.get_z() >= lo.get_z() && p.get_z() <= hi.get_z();
+}
+
+void test_disjoint_sets()
+{
+  const size_t count = 2000;
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<size_t> pick(0, count - 1);
+  std::vector<std::pair<size_t, size_t>> pairs(1500);
+  for (auto& pair : pairs) {
+    pair = std::make_pair(pick(rng), pick(rng));
+  }
+
+  // naive labels: relabel the whole class on every union
+  std::vector<size_t> label(count);
+  for (size_t n = 0; n < count; n++) label[n] = n;
+  for (const auto& pair : pairs) {
+    size_t from = label[pair.first], to = label[pair.second];
+    if (from == to) continue;
+    for (size_t& l : label) {
+      if (l == from) l = to;
+    }
+  }
+  std::vector<size_t> lowest(count, SIZE_MAX);
+  for (size_t n = 0; n < count; n++) {
+    lowest[label[n]] = std::min(lowest[label[n]], n);
+  }
+
+  disjoint_sets serial(count), parallel(count);
+  for (const auto& pair : pairs) {
+    serial.unite(pair.first, pair.second);
+  }
+  parallel_for(pairs.size(), [&](size_t begin, size_t end) {
+    for (size_t n = begin; n < end; n++) {
+      parallel.unite(pairs[n].first, pairs[n].second);
+    }
+  }, 16);
+  for (size_t n = 0; n < count; n++) {
+    // the root is the lowest member, whatever the order of the unions
+    CHECK(serial.find(n) == lowest[label[n]]);
+    CHECK(parallel.find(n) == lowest[label[n]]);
+  }
+}
+
+// two overlapping catalogs, with components, direction-only records and
+// designations that conflict
+void make_catalogs(std::vector<ReadBase::StarData>& first, std::vector<ReadBase::StarData>& second)
+{
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<double> coord(-50.0, 50.0);
+  for (unsigned i = 0; i < 1500; i++) {
+    for (const char *comp : { "A", "B" }) {
+      if (comp[0] == 'B' && i % 10 != 0) break;
+      ReadBase::StarData data;
+      data.is3d = true;
+      data.position = Vector(coord(rng), coord(rng), coord(rng));
+      data.epoch = 2000.0;
+      data.vmag = 4.0;
+      data.SetName(wxString::Format(wxT("Gl %u"), i), ReadBase::PRI_Gliese);
+      if (i % 10 == 0) data.components = comp;
+      if (i % 3 == 0 && comp[0] == 'A') data.AddName(wxString::Format(wxT("HD %u"), i * 7), ReadBase::PRI_HD);
+      if (i % 75 == 0) data.AddName(wxString::Format(wxT("Star %u"), i / 75), ReadBase::PRI_Common);
+      first.push_back(data);
+    }
+  }
+  for (unsigned j = 0; j < 800; j++) {
+    ReadBase::StarData data;
+    data.is3d = j % 4 != 1;
+    data.position = Vector(coord(rng), coord(rng), coord(rng));
+    if (!data.is3d) data.position.normalize();
+    data.epoch = 2000.0;
+    data.vmag = 2.0;
+    data.SetName(wxString::Format(wxT("HR %u"), j), ReadBase::PRI_Other);
+    if (j % 2 == 0) data.AddName(wxString::Format(wxT("HD %u"), j * 21), ReadBase::PRI_HD);
+    if (j % 50 == 0) data.AddName(wxString::Format(wxT("Star %u"), j / 50), ReadBase::PRI_Common);
+    if (j % 5 == 0) data.remarks = wxT("variable");
+    second.push_back(data);
+  }
+}
+
+// everything the merge decides, in star list order
+std::vector<std::string> describe_stars()
+{
+  std::vector<std::string> out;
+  for (const auto list : { &stars, &dir_stars }) {
+    for (const Star *star : *list) {
+      std::string line = std::string(star->is3d ? "3d" : "dir") + " " +
+        std::to_string(star->catalogs) + " " + std::to_string(star->comp) + " " +
+        std::to_string(star->pos.get_x()) + " " + std::string(star->remarks.utf8_str());
+      for (const auto& nit : star->names) {
+        line += "|" + std::string(nit.name.utf8_str());
+      }
+      out.push_back(line);
+    }
+    out.push_back("--");
+  }
+  return out;
+}
+
+void test_merge_order()
+{
+  std::vector<ReadBase::StarData> first, second;
+  make_catalogs(first, second);
+
+  clear_imports();
+  {
+    MemoryCatalog a(wxT("First"), first), b(wxT("Second"), second);
+    import_catalogs({ &a, &b });
+  }
+  std::vector<std::string> bulk = describe_stars();
+
+  clear_imports();
+  {
+    MemoryCatalog a(wxT("First"), first), b(wxT("Second"), second);
+    import_catalog(a);
+    import_catalog(b);
+  }
+  std::vector<std::string> serial = describe_stars();
+
+  CHECK(bulk.size() > 2);
+  CHECK(bulk == serial);
+  CHECK(find_star(wxT("HD 21")) != NULL);
+  clear_imports();
+  index_stars();
+}
+
+void test_star_index()
+{
+  clear_imports();
+  add_random_stars(4000, 3);
+  index_stars();
+
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<double> coord(-110.0, 110.0), size(1.0, 80.0);
+  for (int q = 0; q < 20; q++) {
+    Vector c(coord(rng), coord(rng), coord(rng));
+    double s = size(rng);
+    Vector lo = c - Vector(s, s, s / 2), hi = c + Vector(s, s / 2, s);
+
+    std::vector<Star*> found, want;
+    star_index.ForEachInBox(lo, hi, [&](const StarIndex::Entry& entry) {
+      found.push_back(entry.star);
+    });
+    for (Star *star : star_table) {
+      if (in_box(star->pos, lo, hi)) want.push_back(star);
+    }
+    CHECK(sorted(found) == sorted(want));
+
+    // the subtrees together give the same, in the same order
+    std::vector<uint32_t> subtrees;
+    star_index.GetSubtrees(4, subtrees);
+    std::vector<Star*> pieces;
+    for (uint32_t root : subtrees) {
+      star_index.ForEachInBox(lo, hi, [&](const StarIndex::Entry& entry) {
+        pieces.push_back(entry.star);
+      }, root);
+    }
+    CHECK(pieces == found);
+
+    // with no detail to leave out, the LOD query is the plain one
+    std::vector<Star*> lod;
+    star_index.ForEachInBoxLOD(lo, hi, 1e-9, [&](const StarIndex::Entry& entry) {
+      lod.push_back(entry.star);
+    });
+    CHECK(lod == found);
+
+    // and with tiers over a subset, it's the plain one filtered
+    auto accept = [](const Star *star) { return star->id % 7 == 0; };
+    StarIndex::Tiers tiers;
+    star_index.BuildTiers(tiers, accept);
+    std::vector<Star*> filtered, want_filtered;
+    star_index.ForEachInBoxLOD(lo, hi, 1e-9, [&](const StarIndex::Entry& entry) {
+      filtered.push_back(entry.star);
+    }, tiers, accept);
+    for (Star *star : found) {
+      if (accept(star)) want_filtered.push_back(star);
+    }
+    CHECK(filtered == want_filtered);
+    size_t coarse = 0, bad = 0;
+    star_index.ForEachInBoxLOD(lo, hi, 20.0, [&](const StarIndex::Entry& entry) {
+      coarse++;
+      if (!accept(entry.star) || !in_box(entry.star->pos, lo, hi)) bad++;
+    }, tiers, accept);
+    CHECK(bad == 0 && coarse <= want_filtered.size());
+
+    double r = s / 2;
+    std::vector<Star*> near, want_near;
+    bool dist_ok = true;
+    star_index.ForEachInRadius(c, r, [&](const StarIndex::Entry& entry, double d2) {
+      near.push_back(entry.star);
+      dist_ok = dist_ok && fabs(d2 - (entry.star->pos - c).sqr()) < 1e-9;
+    });
+    for (Star *star : star_table) {
+      if ((star->pos - c).sqr() <= r * r) want_near.push_back(star);
+    }
+    CHECK(sorted(near) == sorted(want_near));
+    CHECK(dist_ok);
+
+    const Star *skip = star_table[q];
+    std::vector<StarIndex::Neighbour> nearest;
+    star_index.Nearest(c, 7, nearest, skip);
+    std::vector<double> want_dist;
+    for (Star *star : star_table) {
+      if (star != skip) want_dist.push_back((star->pos - c).norm());
+    }
+    std::sort(want_dist.begin(), want_dist.end());
+    CHECK(nearest.size() == 7);
+    for (size_t n = 0; n < nearest.size() && n < want_dist.size(); n++) {
+      CHECK(fabs(nearest[n].first - want_dist[n]) < 1e-9);
+      CHECK(nearest[n].second != skip);
+    }
+  }
+
+  // one patch for the whole catalog: its four brightest, known magnitudes first
+  std::vector<double> mags;
+  for (Star *star : star_table) {
+    if (!std::isnan(star->vmag)) mags.push_back(star->vmag);
+  }
+  std::sort(mags.begin(), mags.end());
+  std::vector<double> top;
+  Vector all(1e9, 1e9, 1e9);
+  star_index.ForEachInBoxLOD(all * -1.0, all, 1e9, [&](const StarIndex::Entry& entry) {
+    top.push_back(entry.star->vmag);
+  });
+  CHECK(top.size() == 4);
+  CHECK(std::vector<double>(mags.begin(), mags.begin() + 4) == top);
+}
+
+void test_kinetic_index()
+{
+  // uses the stars of test_star_index
+  KineticIndex index;
+  index.Build(2000.0, 5000.0);
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> coord(-100.0, 100.0);
+  for (double epoch : { 2000.0, 4500.0, -1000.0 }) {
+    Vector c(coord(rng), coord(rng), coord(rng));
+    Vector lo = c - Vector(30, 30, 30), hi = c + Vector(30, 30, 30);
+    std::vector<Star*> found, want;
+    index.ForEachInBox(lo, hi, epoch, [&](const StarIndex::Entry& entry, const Vector&) {
+      found.push_back(entry.star);
+    });
+    for (Star *star : star_table) {
+      if (in_box(star->pos + star->motion * (epoch - star->epoch), lo, hi)) want.push_back(star);
+    }
+    CHECK(sorted(found) == sorted(want));
+  }
+}
+
+void test_ref_distances()
+{
+  // uses the stars of test_star_index, plus some at the same places
+  std::vector<Star*> twins;
+  for (size_t n = 0; n < 50; n++) {
+    twins.push_back(add_star(wxT("Twin"), star_table[n * 13]->pos));
+  }
+  index_stars();
+
+  Vector ref(12.5, -40.0, 7.0);
+  ref_distances.Update(ref);
+  const std::vector<uint32_t>& order = ref_distances.GetOrder();
+  CHECK(order.size() == star_table.size());
+  std::vector<size_t> place(star_table.size(), SIZE_MAX);
+  for (size_t n = 0; n < order.size(); n++) {
+    if (order[n] < place.size()) place[order[n]] = n;
+  }
+  CHECK(std::find(place.begin(), place.end(), SIZE_MAX) == place.end());
+  bool nearest_first = true, close = true;
+  for (size_t n = 0; n < order.size(); n++) {
+    const Star *star = star_table[order[n]];
+    float dist = ref_distances.Get(star);
+    close = close && fabs(dist - (star->pos - ref).norm()) < 1e-3;
+    if (n > 0) nearest_first = nearest_first && ref_distances.Get(star_table[order[n - 1]]) <= dist;
+  }
+  CHECK(nearest_first);
+  CHECK(close);
+  // stars at the same distance stay in id order
+  for (size_t n = 0; n < twins.size(); n++) {
+    const Star *original = star_table[n * 13];
+    CHECK(original->id < twins[n]->id && place[original->id] < place[twins[n]->id]);
+  }
+}
+
+void test_sky_index()
+{
+  std::mt19937 rng(6);
+  std::normal_distribution<double> normal;
+  std::vector<Star> sky_stars(5000);
+  SkyIndex index;
+  for (Star& star : sky_stars) {
+    Vector dir(normal(rng), normal(rng), normal(rng));
+    dir.normalize();
+    star.pos = dir;
+    index.Add(&star, dir);
+  }
+  index.Build();
+
+  std::vector<Vector> dirs = { Vector(0, 0, 1), Vector(0, 0, -1), Vector(1, 0, 0) };
+  for (int n = 0; n < 5; n++) {
+    Vector dir(normal(rng), normal(rng), normal(rng));
+    dir.normalize();
+    dirs.push_back(dir);
+  }
+  for (const Vector& dir : dirs) {
+    for (double radius : { 0.01, 0.2, 1.0, 2.0, 3.2 }) {
+      std::vector<Star*> found, want;
+      index.Cone(dir, radius, found);
+      double cos_r = cos(radius);
+      for (Star& star : sky_stars) {
+        double cos_sep = star.pos.get_x() * dir.get_x() + star.pos.get_y() * dir.get_y() +
+                         star.pos.get_z() * dir.get_z();
+        if (cos_sep >= cos_r) want.push_back(&star);
+      }
+      CHECK(sorted(found) == sorted(want));
+    }
+  }
+}
+
+void test_star_cache()
+{
+  // uses the stars of test_star_index
+  const char *path = "core_tests.cache";
+  neighbour_graph.Build(MAX_NEIGHBOURS);
+  CHECK(save_star_cache(wxT("core_tests.cache"), false));
+  std::vector<std::string> before = describe_stars();
+  std::vector<unsigned> counts = neighbour_graph.GetCounts();
+  std::vector<std::pair<double, unsigned>> links;
+  for (const auto& link : neighbour_graph.GetLinks()) {
+    links.emplace_back(link.first, link.second ? link.second->id : UINT_MAX);
+  }
+
+  clear_imports();
+  index_stars();
+  CHECK(load_star_cache(wxT("core_tests.cache"), false));
+  CHECK(describe_stars() == before);
+  CHECK(neighbour_graph.GetK() == MAX_NEIGHBOURS);
+  CHECK(neighbour_graph.GetCounts() == counts);
+  bool same = neighbour_graph.GetLinks().size() == links.size();
+  for (size_t id = 0; same && id < counts.size(); id++) {
+    for (size_t n = id * MAX_NEIGHBOURS; n < id * MAX_NEIGHBOURS + counts[id]; n++) {
+      const auto& link = neighbour_graph.GetLinks()[n];
+      same = same && link.first == links[n].first && link.second->id == links[n].second;
+    }
+  }
+  CHECK(same);
+  // other options, and a damaged file, are turned down
+  clear_imports();
+  index_stars();
+  CHECK(!load_star_cache(wxT("core_tests.cache"), true));
+  FILE *file = fopen(path, "r+b");
+  CHECK(file != NULL);
+  if (file) {
+    fseek(file, 8 + 4, SEEK_SET); // the byte order mark, after magic and version
+    const unsigned char swapped[4] = { 1, 2, 3, 4 };
+    fwrite(swapped, 1, sizeof(swapped), file);
+    fclose(file);
+  }
+  CHECK(!load_star_cache(wxT("core_tests.cache"), false));
+  CHECK(stars.empty());
+  remove(path);
+}
+
+int write_query_cache(const char *path)
+{
+  clear_imports();
+  add_star(wxT("Alpha Test"), Vector(1, 0, 0));
+  add_star(wxT("Beta Test"), Vector(1, 0, 5));
+  add_star(wxT("Gamma Test"), Vector(1, 3, 0));
+  adopt_stars({ wxT("Test catalog") });
+  index_stars();
+  neighbour_graph.Build(MAX_NEIGHBOURS);
+  if (!save_star_cache(wxString::FromUTF8(path), false)) {
+    fprintf(stderr, "core_tests: couldn't write %s\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+  wxInitializer init;
+  if (!init.IsOk()) {
+    fprintf(stderr, "core_tests: couldn't initialize wxWidgets\n");
+    return 1;
+  }
+  if (argc == 3 && strcmp(argv[1], "--write-query-cache") == 0) return write_query_cache(argv[2]);
+
+  test_disjoint_sets();
+  test_merge_order();
+  test_star_index();
+  test_kinetic_index();
+  test_ref_distances();
+  test_sky_index();
+  test_star_cache();
+
+  if (failures) fprintf(stderr, "core_tests: %d checks failed\n", failures);
+  return failures ? 1 : 0;
+}